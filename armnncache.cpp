@@ -0,0 +1,104 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "armnncache.h"
+
+armnnCache::armnnCache(const QString &cacheDirectory, const QString &modelLocation, const QString &armnnVersion,
+                       const QStringList &backends, bool fp16, bool fastMath) :
+    directory(cacheDirectory)
+{
+    QCryptographicHash modelHash(QCryptographicHash::Sha256);
+    QCryptographicHash configurationHash(QCryptographicHash::Sha256);
+    QFile model(modelLocation);
+    QJsonObject entry;
+
+    if (model.open(QIODevice::ReadOnly))
+        modelHash.addData(&model);
+    else
+        qWarning() << "Could not read" << modelLocation << "to key the ArmNN cache";
+
+    configurationHash.addData(armnnVersion.toUtf8());
+    configurationHash.addData(backends.join(",").toUtf8());
+    configurationHash.addData(fp16 ? "fp16" : "fp32");
+    configurationHash.addData(fastMath ? "fastmath" : "precise");
+
+    entryName = QFileInfo(modelLocation).completeBaseName() + "-" +
+                modelHash.result().toHex().left(ARMNN_CACHE_HASH_LENGTH) + "-" +
+                configurationHash.result().toHex().left(ARMNN_CACHE_HASH_LENGTH);
+
+    entry["model"] = QFileInfo(modelLocation).absoluteFilePath();
+    entry["model_sha256"] = QString(modelHash.result().toHex());
+    entry["armnn_version"] = armnnVersion;
+    entry["backends"] = backends.join(",");
+    entry["fp16"] = fp16;
+    entry["fast_math"] = fastMath;
+    metadata = QJsonDocument(entry).toJson();
+
+    if (!QDir().mkpath(directory))
+        qWarning() << "Could not create the ArmNN cache directory" << directory;
+
+    removeStaleEntries();
+}
+
+QString armnnCache::getNetworkPath()
+{
+    return QDir(directory).filePath(entryName + ".bin");
+}
+
+bool armnnCache::isValid()
+{
+    return QFile::exists(getNetworkPath()) && QFile::exists(QDir(directory).filePath(entryName + ".json"));
+}
+
+/* Record the network as complete, called once ArmNN has written it */
+void armnnCache::markValid()
+{
+    QFile file(QDir(directory).filePath(entryName + ".json"));
+
+    if (!QFile::exists(getNetworkPath()))
+        return;
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(metadata.toUtf8()) < 0)
+        qWarning() << "Could not write the ArmNN cache entry" << file.fileName();
+}
+
+void armnnCache::invalidate()
+{
+    QFile::remove(QDir(directory).filePath(entryName + ".json"));
+    QFile::remove(getNetworkPath());
+}
+
+/* Remove the entries for other versions of this model or configuration */
+void armnnCache::removeStaleEntries()
+{
+    QDir cacheDirectory(directory);
+    QString prefix = entryName.left(entryName.size() - 2 * ARMNN_CACHE_HASH_LENGTH - 2);
+
+    for (const QFileInfo &file : cacheDirectory.entryInfoList({prefix + "-*"}, QDir::Files)) {
+        if (file.completeBaseName() != entryName && file.completeBaseName().size() == entryName.size())
+            QFile::remove(file.absoluteFilePath());
+    }
+}
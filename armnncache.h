@@ -0,0 +1,52 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef ARMNNCACHE_H
+#define ARMNNCACHE_H
+
+#define ARMNN_CACHE_HASH_LENGTH 16
+
+#include <QString>
+#include <QStringList>
+
+/*
+ * Locates the on-disk cache of an optimised ArmNN network. Entries are keyed
+ * on a hash of the model file, the ArmNN version, the backends and the
+ * optimiser options, so a change to any of them selects a new entry and the
+ * stale ones for the same model are removed. An entry is only trusted once
+ * its metadata file has been written after a successful build
+ */
+class armnnCache
+{
+public:
+    armnnCache(const QString &cacheDirectory, const QString &modelLocation, const QString &armnnVersion,
+               const QStringList &backends, bool fp16, bool fastMath);
+    QString getNetworkPath();
+    bool isValid();
+    void markValid();
+    void invalidate();
+
+private:
+    void removeStaleEntries();
+
+    QString directory;
+    QString entryName;
+    QString metadata;
+};
+
+#endif // ARMNNCACHE_H
@@ -0,0 +1,323 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "benchmark.h"
+#include "imagepreprocessor.h"
+#include "tfliteworker.h"
+
+/* Return the mean time in microseconds taken by one call of the function */
+static double timeFunction(unsigned int iterations, std::function<void()> function)
+{
+    std::chrono::steady_clock::time_point startTime;
+
+    /* Warm up the caches and the page tables of the buffers */
+    function();
+
+    startTime = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++)
+        function();
+
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() / iterations;
+}
+
+/*
+ * Compare the OpenCV preprocessing chain previously used for every frame with
+ * the fused kernel, on a synthetic camera frame
+ */
+int runPreprocessBenchmark(unsigned int iterations)
+{
+    QTextStream output(stdout);
+    imagePreprocessor preprocessor;
+    cv::Mat uyvyFrame(BENCHMARK_FRAME_HEIGHT, BENCHMARK_FRAME_WIDTH, CV_8UC2);
+    cv::Mat rgbFrame;
+    std::vector<uint8_t> tensor(BENCHMARK_MODEL_SIZE * BENCHMARK_MODEL_SIZE * 3);
+    double opencvTime, fusedUyvyTime, fusedRgbTime;
+
+    if (iterations == 0)
+        iterations = 1;
+
+    cv::randu(uyvyFrame, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::cvtColor(uyvyFrame, rgbFrame, cv::COLOR_YUV2RGB_UYVY);
+
+    /* cv::VideoCapture conversion, BGR to RGB, resize and tensor copy */
+    opencvTime = timeFunction(iterations, [&]() {
+        cv::Mat bgrFrame, resizedFrame;
+
+        cv::cvtColor(uyvyFrame, bgrFrame, cv::COLOR_YUV2BGR_UYVY);
+        cv::cvtColor(bgrFrame, bgrFrame, cv::COLOR_BGR2RGB);
+        cv::resize(bgrFrame, resizedFrame, cv::Size(BENCHMARK_MODEL_SIZE, BENCHMARK_MODEL_SIZE));
+        memcpy(tensor.data(), resizedFrame.data, resizedFrame.total() * resizedFrame.elemSize());
+    });
+
+    fusedUyvyTime = timeFunction(iterations, [&]() {
+        preprocessor.process(uyvyFrame.data, uyvyFrame.step, PIXEL_FORMAT_UYVY,
+                             uyvyFrame.cols, uyvyFrame.rows,
+                             tensor.data(), BENCHMARK_MODEL_SIZE, BENCHMARK_MODEL_SIZE);
+    });
+
+    fusedRgbTime = timeFunction(iterations, [&]() {
+        preprocessor.process(rgbFrame.data, rgbFrame.step, PIXEL_FORMAT_RGB888,
+                             rgbFrame.cols, rgbFrame.rows,
+                             tensor.data(), BENCHMARK_MODEL_SIZE, BENCHMARK_MODEL_SIZE);
+    });
+
+    output << "Preprocessing " << BENCHMARK_FRAME_WIDTH << "x" << BENCHMARK_FRAME_HEIGHT
+           << " to " << BENCHMARK_MODEL_SIZE << "x" << BENCHMARK_MODEL_SIZE
+           << ", " << iterations << " iterations, "
+           << imagePreprocessor::getInstructionSet() << " kernels\n";
+    output << "  OpenCV UYVY->BGR->RGB + resize + memcpy: " << opencvTime << " us\n";
+    output << "  Fused UYVY->RGB + resize:                " << fusedUyvyTime << " us\n";
+    output << "  Fused RGB + resize:                      " << fusedRgbTime << " us\n";
+
+    return 0;
+}
+
+/*
+ * Load the benchmark frames as RGB, either every image in a directory or the
+ * first BENCHMARK_MAX_VIDEO_FRAMES frames of a video file
+ */
+static std::vector<cv::Mat> loadFrames(const QString &inputLocation)
+{
+    std::vector<cv::Mat> frames;
+    cv::Mat frame;
+
+    if (QFileInfo(inputLocation).isDir()) {
+        QDir directory(inputLocation);
+        QStringList filters = {"*.bmp", "*.jpeg", "*.jpg", "*.png"};
+
+        for (const QFileInfo &file : directory.entryInfoList(filters, QDir::Files, QDir::Name)) {
+            frame = cv::imread(file.absoluteFilePath().toStdString());
+
+            if (frame.empty()) {
+                qWarning() << "Could not read" << file.absoluteFilePath();
+                continue;
+            }
+
+            cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
+            frames.push_back(frame);
+        }
+    } else {
+        cv::VideoCapture video(inputLocation.toStdString());
+
+        while (frames.size() < BENCHMARK_MAX_VIDEO_FRAMES && video.read(frame)) {
+            cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
+            frames.push_back(frame.clone());
+        }
+    }
+
+    return frames;
+}
+
+/* Nearest rank percentile of a sorted list */
+static double percentile(const std::vector<double> &sortedValues, double rank)
+{
+    size_t index = size_t(std::ceil(rank / 100.0 * sortedValues.size()));
+
+    if (sortedValues.empty())
+        return 0;
+
+    return sortedValues[std::min(std::max(index, size_t(1)), sortedValues.size()) - 1];
+}
+
+/*
+ * Push the frames through a tfliteWorker exactly as the application does,
+ * keeping one request in flight for each interpreter so none are dropped.
+ * Latency is measured from submission to the result being emitted
+ */
+static QJsonObject benchmarkConfiguration(tfliteWorker &worker, const std::vector<cv::Mat> &frames,
+                                          const inferenceSettings &settings, bool useDelegate,
+                                          unsigned int iterations, unsigned int warmup)
+{
+    QMetaObject::Connection connection;
+    std::mutex resultMutex;
+    std::condition_variable resultCondition;
+    std::map<quint64, std::chrono::steady_clock::time_point> submitTimes;
+    std::vector<double> latencies;
+    quint64 warmupInvocations = 0, warmupInvokeMicroseconds = 0;
+    quint64 invocations, invokeMicroseconds;
+    quint64 detectionTotal = 0;
+    unsigned int completed = 0;
+    unsigned int total = iterations + warmup;
+    size_t inFlightLimit = size_t(std::max(settings.interpreterCount, 1));
+    std::chrono::steady_clock::time_point startTime;
+    QJsonObject latency;
+    QJsonObject result;
+    double elapsedSeconds;
+
+    worker.setDelegate(useDelegate);
+
+    /* A delegate switch warms the interpreters up again, don't time against it */
+    worker.waitForWarmup();
+
+    /* Without a context object the lambda runs on the interpreter thread */
+    connection = QObject::connect(&worker, &tfliteWorker::sendOutputTensor,
+                     [&](const detectionResult& detections, int, const cv::Mat&, quint64 requestId) {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        if (completed >= warmup) {
+            latencies.push_back(std::chrono::duration<double, std::milli>(now - submitTimes[requestId]).count());
+            detectionTotal += quint64(detections->size());
+        }
+
+        submitTimes.erase(requestId);
+        completed++;
+
+        resultCondition.notify_one();
+    });
+
+    for (unsigned int i = 0; i < total; i++) {
+        quint64 requestId;
+
+        {
+            std::unique_lock<std::mutex> lock(resultMutex);
+
+            /*
+             * Let the warm-up requests finish before timing, so the throughput
+             * and the worker's invoke totals only cover the timed requests
+             */
+            if (i == warmup) {
+                resultCondition.wait(lock, [&]() { return completed == warmup; });
+                worker.getInvokeTotals(warmupInvocations, warmupInvokeMicroseconds);
+                startTime = std::chrono::steady_clock::now();
+            }
+
+            resultCondition.wait(lock, [&]() { return submitTimes.size() < inFlightLimit; });
+
+            /* Reserve the id so the time is stored before the result can arrive */
+            requestId = worker.reserveRequest();
+            submitTimes[requestId] = std::chrono::steady_clock::now();
+        }
+
+        /* Results can be emitted from within submitImage, so don't hold the lock */
+        worker.submitImage(frames[i % frames.size()], requestId);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(resultMutex);
+
+        resultCondition.wait(lock, [&]() { return completed == total; });
+        elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    QObject::disconnect(connection);
+
+    worker.getInvokeTotals(invocations, invokeMicroseconds);
+    invocations -= warmupInvocations;
+    invokeMicroseconds -= warmupInvokeMicroseconds;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    latency["p50"] = percentile(latencies, 50);
+    latency["p90"] = percentile(latencies, 90);
+    latency["p99"] = percentile(latencies, 99);
+    latency["max"] = latencies.back();
+
+    result["delegate"] = useDelegate ? QString(DELEGATE_NAME).toLower() : "tflite";
+    result["latency_ms"] = latency;
+    result["mean_inference_ms"] = invocations > 0 ? invokeMicroseconds / 1000.0 / invocations : 0;
+    result["throughput_fps"] = elapsedSeconds > 0 ? iterations / elapsedSeconds : 0;
+    result["detections_per_frame"] = double(detectionTotal) / iterations;
+
+    return result;
+}
+
+/*
+ * Run the detection model over a directory of images or a video file without
+ * a camera or GUI and print the results as JSON, once for each delegate
+ */
+int runInferenceBenchmark(const QString &inputLocation, const QString &modelLocation,
+                          const inferenceSettings &settings, const QStringList &delegates,
+                          unsigned int iterations, unsigned int warmup)
+{
+    QTextStream output(stdout);
+    std::vector<cv::Mat> frames = loadFrames(inputLocation);
+    QJsonArray configurations;
+    QJsonObject report;
+    QStringList runDelegates;
+
+    if (frames.empty()) {
+        qWarning() << "No frames could be loaded from" << inputLocation;
+        return 1;
+    }
+
+    if (iterations == 0)
+        iterations = 1;
+
+    /* The delegate available depends on the build, ArmNN on Arm and XNNPACK on x86 */
+    for (const QString &delegate : delegates) {
+        if (delegate != "tflite" && delegate != "armnn" && delegate != "xnnpack") {
+            qWarning() << "Unknown delegate" << delegate;
+            return 1;
+        }
+
+        if (delegate != "tflite" && delegate != QString(DELEGATE_NAME).toLower()) {
+            qWarning() << "The" << delegate << "delegate is not available in this build, skipping it";
+            continue;
+        }
+
+        runDelegates << delegate;
+    }
+
+    if (!runDelegates.isEmpty()) {
+        tfliteWorker worker(modelLocation, runDelegates.first() != "tflite", settings);
+
+        /* Don't let the background interpreter builds run during the timing */
+        worker.waitForInterpreters();
+
+        for (const QString &delegate : runDelegates)
+            configurations.append(benchmarkConfiguration(worker, frames, settings, delegate != "tflite",
+                                                         iterations, warmup));
+    }
+
+    report["input"] = inputLocation;
+    report["model"] = modelLocation;
+    report["frames"] = int(frames.size());
+    report["iterations"] = int(iterations);
+    report["warmup"] = int(warmup);
+    report["interpreters"] = std::max(settings.interpreterCount, 1);
+    report["configurations"] = configurations;
+
+    output << QJsonDocument(report).toJson();
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#define BENCHMARK_FRAME_WIDTH 800
+#define BENCHMARK_FRAME_HEIGHT 600
+#define BENCHMARK_MODEL_SIZE 300
+#define BENCHMARK_MAX_VIDEO_FRAMES 300
+
+#include <QStringList>
+
+struct inferenceSettings;
+
+int runPreprocessBenchmark(unsigned int iterations);
+int runInferenceBenchmark(const QString &inputLocation, const QString &modelLocation,
+                          const inferenceSettings &settings, const QStringList &delegates,
+                          unsigned int iterations, unsigned int warmup);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,119 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/*
+ * Fixed capacity queue used to hand work between pipeline stages. When the
+ * consumer falls behind the oldest item is dropped rather than blocking the
+ * producer, so a slow stage never stalls the stages before it
+ */
+template <typename T>
+class boundedQueue
+{
+public:
+    explicit boundedQueue(size_t maximumSize) :
+        capacity(maximumSize), closed(false), dropped(0)
+    {}
+
+    /* Returns false if an older item had to be dropped to make room */
+    bool push(T item)
+    {
+        T droppedItem;
+
+        return push(std::move(item), droppedItem);
+    }
+
+    /* As above, handing the dropped item back so the caller can retire it */
+    bool push(T item, T &droppedItem)
+    {
+        bool overflowed = false;
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+
+            if (items.size() >= capacity) {
+                droppedItem = std::move(items.front());
+                items.pop_front();
+                dropped++;
+                overflowed = true;
+            }
+
+            items.push_back(std::move(item));
+        }
+
+        itemAvailable.notify_one();
+
+        return !overflowed;
+    }
+
+    /* Block until an item is available, returns false once the queue is closed */
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+
+        itemAvailable.wait(lock, [this]() { return closed || !items.empty(); });
+
+        if (closed)
+            return false;
+
+        item = std::move(items.front());
+        items.pop_front();
+
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            closed = true;
+            items.clear();
+        }
+
+        itemAvailable.notify_all();
+    }
+
+    void reopen()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        closed = false;
+        dropped = 0;
+    }
+
+    unsigned long getDropped()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return dropped;
+    }
+
+private:
+    size_t capacity;
+    bool closed;
+    unsigned long dropped;
+    std::deque<T> items;
+    std::mutex queueMutex;
+    std::condition_variable itemAvailable;
+};
+
+#endif // BOUNDEDQUEUE_H
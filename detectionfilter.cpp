@@ -0,0 +1,200 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <string.h>
+
+#include "detectionfilter.h"
+#include "latencystats.h"
+
+typedef float floatVector __attribute__((vector_size(FILTER_VECTOR_WIDTH * sizeof(float))));
+
+/* Boxes of different classes are moved this far apart so they never overlap */
+#define FILTER_CLASS_OFFSET 2.0f
+
+/* Coordinate of the padding boxes, far away from every real box */
+#define FILTER_PADDING_COORDINATE -1.0e6f
+
+detectionFilter::detectionFilter(float defaultThreshold, float iouThreshold, int topK) :
+    defaultScoreThreshold(defaultThreshold), nmsIouThreshold(iouThreshold), maximumDetections(topK),
+    keptCount(0)
+{
+}
+
+/*
+ * Read per-class score thresholds from a JSON file, classes are given by
+ * their index in the label list:
+ *   { "default": 0.5, "classes": { "1": 0.6, "4": 0.7 } }
+ */
+bool detectionFilter::loadThresholds(const QString &fileName)
+{
+    QFile file(fileName);
+    QJsonObject thresholds;
+    QJsonObject classes;
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open the threshold file" << fileName;
+        return false;
+    }
+
+    thresholds = QJsonDocument::fromJson(file.readAll()).object();
+
+    if (thresholds.isEmpty()) {
+        qWarning() << "Could not parse the threshold file" << fileName;
+        return false;
+    }
+
+    defaultScoreThreshold = float(thresholds.value("default").toDouble(double(defaultScoreThreshold)));
+    classes = thresholds.value("classes").toObject();
+
+    for (QJsonObject::const_iterator entry = classes.constBegin(); entry != classes.constEnd(); ++entry) {
+        bool valid;
+        int item = entry.key().toInt(&valid);
+
+        if (!valid || item < 0) {
+            qWarning() << "Ignoring the threshold for unknown class" << entry.key();
+            continue;
+        }
+
+        while (classThresholds.size() <= item)
+            classThresholds.append(-1.0f);
+
+        classThresholds[item] = float(entry.value().toDouble());
+    }
+
+    return true;
+}
+
+float detectionFilter::getThreshold(int item)
+{
+    if (item >= 0 && item < classThresholds.size() && classThresholds[item] >= 0)
+        return classThresholds[item];
+
+    return defaultScoreThreshold;
+}
+
+/* Candidates below this score can never pass, so the decoder can skip them */
+float detectionFilter::getMinimumThreshold()
+{
+    float minimum = defaultScoreThreshold;
+
+    for (float threshold : classThresholds) {
+        if (threshold >= 0)
+            minimum = std::min(minimum, threshold);
+    }
+
+    return minimum;
+}
+
+/*
+ * Compare a box against every kept box, FILTER_VECTOR_WIDTH at a time.
+ * Instead of dividing, the intersection is compared against the threshold
+ * times the union
+ */
+bool detectionFilter::overlapsKept(float x1, float y1, float x2, float y2, float area)
+{
+    floatVector boxX1 = {x1, x1, x1, x1};
+    floatVector boxY1 = {y1, y1, y1, y1};
+    floatVector boxX2 = {x2, x2, x2, x2};
+    floatVector boxY2 = {y2, y2, y2, y2};
+    floatVector boxArea = {area, area, area, area};
+    floatVector threshold = {nmsIouThreshold, nmsIouThreshold, nmsIouThreshold, nmsIouThreshold};
+    floatVector zero = {0, 0, 0, 0};
+
+    for (size_t i = 0; i < keptCount; i += FILTER_VECTOR_WIDTH) {
+        floatVector keptBoxX1, keptBoxY1, keptBoxX2, keptBoxY2, keptBoxArea;
+        floatVector width, height, intersection, overlaps;
+
+        memcpy(&keptBoxX1, &keptX1[i], sizeof(floatVector));
+        memcpy(&keptBoxY1, &keptY1[i], sizeof(floatVector));
+        memcpy(&keptBoxX2, &keptX2[i], sizeof(floatVector));
+        memcpy(&keptBoxY2, &keptY2[i], sizeof(floatVector));
+        memcpy(&keptBoxArea, &keptArea[i], sizeof(floatVector));
+
+        width = (keptBoxX2 < boxX2 ? keptBoxX2 : boxX2) - (keptBoxX1 > boxX1 ? keptBoxX1 : boxX1);
+        height = (keptBoxY2 < boxY2 ? keptBoxY2 : boxY2) - (keptBoxY1 > boxY1 ? keptBoxY1 : boxY1);
+        width = width > zero ? width : zero;
+        height = height > zero ? height : zero;
+        intersection = width * height;
+
+        overlaps = intersection > threshold * (keptBoxArea + boxArea - intersection) ? zero + 1 : zero;
+
+        if (overlaps[0] + overlaps[1] + overlaps[2] + overlaps[3] > 0)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Apply the class thresholds, class-aware non-maximum suppression and the
+ * top-K cap. The candidates do not need to be sorted
+ */
+void detectionFilter::apply(const detectionList &candidates, detectionList &detections)
+{
+    stageTimer timer(STAGE_POSTPROCESS);
+    size_t paddedSize = (candidates.size() + FILTER_VECTOR_WIDTH - 1) / FILTER_VECTOR_WIDTH * FILTER_VECTOR_WIDTH;
+
+    order.clear();
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (candidates[i].confidence >= getThreshold(candidates[i].item))
+            order.push_back(int(i));
+    }
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return candidates[size_t(a)].confidence > candidates[size_t(b)].confidence;
+    });
+
+    keptX1.assign(paddedSize, FILTER_PADDING_COORDINATE);
+    keptY1.assign(paddedSize, FILTER_PADDING_COORDINATE);
+    keptX2.assign(paddedSize, FILTER_PADDING_COORDINATE);
+    keptY2.assign(paddedSize, FILTER_PADDING_COORDINATE);
+    keptArea.assign(paddedSize, 0);
+    keptCount = 0;
+
+    for (int index : order) {
+        const detection &candidate = candidates[size_t(index)];
+        float offset = candidate.item * FILTER_CLASS_OFFSET;
+        float x1 = candidate.xmin + offset;
+        float y1 = candidate.ymin + offset;
+        float x2 = candidate.xmax + offset;
+        float y2 = candidate.ymax + offset;
+        float area = std::max(x2 - x1, 0.0f) * std::max(y2 - y1, 0.0f);
+
+        if (maximumDetections > 0 && int(detections.size()) >= maximumDetections)
+            break;
+
+        if (nmsIouThreshold < 1.0f && overlapsKept(x1, y1, x2, y2, area))
+            continue;
+
+        keptX1[keptCount] = x1;
+        keptY1[keptCount] = y1;
+        keptX2[keptCount] = x2;
+        keptY2[keptCount] = y2;
+        keptArea[keptCount] = area;
+        keptCount++;
+
+        detections.push_back(candidate);
+    }
+}
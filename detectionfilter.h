@@ -0,0 +1,60 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef DETECTIONFILTER_H
+#define DETECTIONFILTER_H
+
+#define FILTER_VECTOR_WIDTH 4
+
+#include <QString>
+#include <QVector>
+
+#include <vector>
+
+#include "detectionresult.h"
+
+/*
+ * Post-processing applied to the raw detections of the model. Each class has
+ * its own score threshold, overlapping boxes of the same class are reduced to
+ * the highest scoring one by non-maximum suppression and at most topK
+ * detections are kept. The filter keeps scratch buffers, so each thread needs
+ * its own copy
+ */
+class detectionFilter
+{
+public:
+    detectionFilter(float defaultThreshold, float iouThreshold, int topK);
+    bool loadThresholds(const QString &fileName);
+    float getMinimumThreshold();
+    void apply(const detectionList &candidates, detectionList &detections);
+
+private:
+    float getThreshold(int item);
+    bool overlapsKept(float x1, float y1, float x2, float y2, float area);
+
+    float defaultScoreThreshold;
+    float nmsIouThreshold;
+    int maximumDetections;
+    QVector<float> classThresholds;
+    std::vector<int> order;
+    /* Kept boxes as separate coordinate arrays, padded to the vector width */
+    std::vector<float> keptX1, keptY1, keptX2, keptY2, keptArea;
+    size_t keptCount;
+};
+
+#endif // DETECTIONFILTER_H
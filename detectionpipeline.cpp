@@ -0,0 +1,311 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+
+#include "detectionpipeline.h"
+#include "latencystats.h"
+#include "tfliteworker.h"
+#include "videoworker.h"
+
+detectionPipeline::detectionPipeline(opencvWorker *capture, tfliteWorker *inference, videoWorker *render,
+                                     int trackingInterval, float sceneThreshold) :
+    cvWorker(capture), tfWorker(inference), vidWorker(render),
+    renderQueue(PIPELINE_QUEUE_SIZE), trackedPool(PIPELINE_TRACKED_DETECTIONS), lastInferenceTime(0),
+    running(false), framesSubmitted(0), framesInferred(0), framesTracked(0), framesUnchanged(0)
+{
+    if (trackingInterval > 0)
+        tracker.reset(new objectTracker(trackingInterval));
+
+    if (sceneThreshold > 0.0f)
+        sceneDetector.reset(new sceneChangeDetector(sceneThreshold));
+
+    /* Results are taken straight from the interpreter threads and queued for
+     * the render stage, without going through an event loop */
+    connect(tfWorker, SIGNAL(sendOutputTensor(const detectionResult&, int, const cv::Mat&, quint64)),
+            this, SLOT(receiveResult(const detectionResult&, int, const cv::Mat&, quint64)),
+            Qt::DirectConnection);
+}
+
+detectionPipeline::~detectionPipeline()
+{
+    stop();
+}
+
+void detectionPipeline::start()
+{
+    if (running)
+        return;
+
+    running = true;
+    framesSubmitted = 0;
+    framesInferred = 0;
+    framesTracked = 0;
+    framesUnchanged = 0;
+    lastInferenceTime = 0;
+    lastDetections = nullptr;
+    renderQueue.reopen();
+
+    if (sceneDetector != nullptr)
+        sceneDetector->reset();
+
+    if (tracker != nullptr) {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        tracker->reset();
+    }
+
+    preprocessThread = std::thread(&detectionPipeline::preprocessLoop, this);
+    renderThread = std::thread(&detectionPipeline::renderLoop, this);
+}
+
+void detectionPipeline::stop()
+{
+    if (!running)
+        return;
+
+    running = false;
+
+    /* Wake up the render stage if it is waiting for a result */
+    renderQueue.close();
+
+    preprocessThread.join();
+    renderThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        pipelineRequests.clear();
+    }
+
+    qInfo() << "Live detection stopped, frames submitted:" << quint64(framesSubmitted)
+            << "inferred:" << quint64(framesInferred)
+            << "tracked:" << quint64(framesTracked)
+            << "unchanged:" << quint64(framesUnchanged)
+            << "dropped before rendering:" << renderQueue.getDropped();
+}
+
+bool detectionPipeline::isRunning()
+{
+    return running;
+}
+
+/*
+ * Take every new camera frame, convert it into the model input layout and
+ * hand it to the interpreter pool. The pool's request queue drops the oldest
+ * frame when every interpreter is busy. When tracking, every frame is
+ * rendered with the tracked boxes and only frames the detector is due to
+ * run on are submitted
+ */
+void detectionPipeline::preprocessLoop()
+{
+    quint64 lastSequence = 0;
+    quint64 lastDetectedSequence = 0;
+    quint64 requestId;
+    capturedFrame frame;
+
+    while (running) {
+        std::vector<uint8_t> input(tfWorker->getInputSize());
+
+        /* Each frame needs its own buffer as it travels down the pipeline */
+        frame.image = cv::Mat();
+
+        if (!cvWorker->waitForFrame(lastSequence, frame, PIPELINE_FRAME_TIMEOUT_MS)) {
+            if (cvWorker->getCaptureFailed()) {
+                vidWorker->reportCameraFailure();
+                break;
+            }
+
+            continue;
+        }
+
+        lastSequence = frame.sequence;
+
+        if (tracker != nullptr) {
+            pushTrackedFrame(frame);
+
+            if (!isDetectionDue(frame.sequence, lastDetectedSequence) || isSceneUnchanged(frame))
+                continue;
+
+            lastDetectedSequence = frame.sequence;
+        } else if (sceneDetector != nullptr && reusePreviousResult(frame)) {
+            continue;
+        }
+
+        if (!tfWorker->preprocessImage(frame.image, input.data(), preprocessor))
+            continue;
+
+        /*
+         * Record the request before submitting it so its result is always
+         * found, requestMutex must not be held while submitting as results
+         * can be emitted from within submitInput
+         */
+        requestId = tfWorker->reserveRequest();
+
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+            pipelineRequests[requestId] = frame.sequence;
+            framesSubmitted++;
+        }
+
+        tfWorker->submitInput(frame.image, std::move(input), requestId);
+    }
+}
+
+/*
+ * The detector runs once the tracker's interval has passed since it was last
+ * given a frame, and never on more than one frame at a time so its results
+ * are as fresh as possible
+ */
+bool detectionPipeline::isDetectionDue(quint64 sequence, quint64 lastDetectedSequence)
+{
+    int interval;
+
+    {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        interval = tracker->getInterval();
+    }
+
+    if (lastDetectedSequence != 0 && sequence < lastDetectedSequence + quint64(interval))
+        return false;
+
+    std::lock_guard<std::mutex> lock(requestMutex);
+
+    return pipelineRequests.empty();
+}
+
+void detectionPipeline::pushTrackedFrame(const capturedFrame &frame)
+{
+    std::shared_ptr<pipelineFrame> item = std::make_shared<pipelineFrame>();
+    std::shared_ptr<detectionList> detections = trackedPool.acquire();
+
+    {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        tracker->predict(frame.sequence, *detections);
+    }
+
+    item->image = frame.image;
+    item->detections = detections;
+    item->inferenceTime = lastInferenceTime;
+
+    framesTracked++;
+    renderQueue.push(item);
+}
+
+/*
+ * Check the frame against the last one the detector ran on, an unchanged
+ * frame is counted along with the time the detector would have taken on it
+ */
+bool detectionPipeline::isSceneUnchanged(const capturedFrame &frame)
+{
+    latencyStats &stats = latencyStats::instance();
+
+    if (sceneDetector == nullptr)
+        return false;
+
+    stats.increment(COUNTER_SCENE_CHECKED);
+
+    if (sceneDetector->hasChanged(frame.image))
+        return false;
+
+    stats.increment(COUNTER_SCENE_SKIPPED);
+    stats.increment(COUNTER_SCENE_SAVED_US, stats.getMean(STAGE_PREPROCESS) + stats.getMean(STAGE_INVOKE) +
+                    stats.getMean(STAGE_OUTPUT_PARSE) + stats.getMean(STAGE_POSTPROCESS));
+    framesUnchanged++;
+
+    return true;
+}
+
+/*
+ * Show an unchanged frame with the previous detections instead of inferring
+ * it. Only done while no request is in flight, so frames are still shown in
+ * the order they were captured
+ */
+bool detectionPipeline::reusePreviousResult(const capturedFrame &frame)
+{
+    std::shared_ptr<pipelineFrame> item;
+    detectionResult detections;
+
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+
+        if (!pipelineRequests.empty() || lastDetections == nullptr)
+            return false;
+
+        detections = lastDetections;
+    }
+
+    if (!isSceneUnchanged(frame))
+        return false;
+
+    item = std::make_shared<pipelineFrame>();
+    item->image = frame.image;
+    item->detections = detections;
+    item->inferenceTime = lastInferenceTime;
+
+    renderQueue.push(item);
+
+    return true;
+}
+
+/*
+ * Called on an interpreter thread. Results arrive in request order, so any
+ * older request still recorded was dropped by the pool and can be forgotten.
+ * When tracking, the result updates the tracks at the frame it was found in
+ */
+void detectionPipeline::receiveResult(const detectionResult& detections, int inferenceTime,
+                                      const cv::Mat& image, quint64 requestId)
+{
+    std::shared_ptr<pipelineFrame> item;
+    quint64 sequence;
+
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        std::map<quint64, quint64>::iterator request = pipelineRequests.find(requestId);
+
+        if (request == pipelineRequests.end())
+            return;
+
+        sequence = request->second;
+        pipelineRequests.erase(pipelineRequests.begin(), pipelineRequests.upper_bound(requestId));
+        lastDetections = detections;
+    }
+
+    framesInferred++;
+    lastInferenceTime = inferenceTime;
+
+    if (tracker != nullptr) {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        tracker->update(*detections, sequence);
+        return;
+    }
+
+    item = std::make_shared<pipelineFrame>();
+    item->image = image;
+    item->detections = detections;
+    item->inferenceTime = inferenceTime;
+
+    renderQueue.push(item);
+}
+
+/* Draw the detections over the frame they were found in */
+void detectionPipeline::renderLoop()
+{
+    std::shared_ptr<pipelineFrame> item;
+
+    while (renderQueue.pop(item))
+        vidWorker->renderDetections(item->image, item->detections, item->inferenceTime);
+}
@@ -0,0 +1,115 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef DETECTIONPIPELINE_H
+#define DETECTIONPIPELINE_H
+
+#define PIPELINE_QUEUE_SIZE 2
+#define PIPELINE_FRAME_TIMEOUT_MS 500
+#define PIPELINE_TRACKED_DETECTIONS 32
+
+#include <QObject>
+#include <QVector>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "boundedqueue.h"
+#include "detectionresult.h"
+#include "imagepreprocessor.h"
+#include "objecttracker.h"
+#include "opencvworker.h"
+#include "scenechangedetector.h"
+
+class tfliteWorker;
+class videoWorker;
+
+/*
+ * Continuous detection on the live camera feed. Capture, preprocessing,
+ * inference and overlay rendering each run on their own threads and hand
+ * frames to the next stage through drop-oldest queues, so the frame rate is
+ * bounded by the slowest stage rather than by the sum of all of them.
+ *
+ *   opencvWorker capture thread -> preprocess -> tfliteWorker interpreter
+ *   pool -> render -> GUI
+ *
+ * With a tracking interval the detector only sees some of the frames. Every
+ * frame is rendered straight from the preprocess stage with the boxes an
+ * objectTracker predicts for it, and the detector's results only correct
+ * the tracks
+ *
+ * With a scene change threshold, frames that look the same as the last one
+ * the detector ran on are not inferred again. They are shown with the
+ * previous detections, or with the tracked boxes when tracking
+ */
+class detectionPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    detectionPipeline(opencvWorker *capture, tfliteWorker *inference, videoWorker *render,
+                      int trackingInterval, float sceneThreshold);
+    ~detectionPipeline();
+    void start();
+    void stop();
+    bool isRunning();
+
+private slots:
+    void receiveResult(const detectionResult& detections, int inferenceTime, const cv::Mat& image, quint64 requestId);
+
+private:
+    struct pipelineFrame {
+        cv::Mat image;
+        detectionResult detections;
+        int inferenceTime;
+    };
+
+    void preprocessLoop();
+    void renderLoop();
+    bool isDetectionDue(quint64 sequence, quint64 lastDetectedSequence);
+    void pushTrackedFrame(const capturedFrame &frame);
+    bool isSceneUnchanged(const capturedFrame &frame);
+    bool reusePreviousResult(const capturedFrame &frame);
+
+    opencvWorker *cvWorker;
+    tfliteWorker *tfWorker;
+    videoWorker *vidWorker;
+    imagePreprocessor preprocessor;
+    boundedQueue<std::shared_ptr<pipelineFrame>> renderQueue;
+    std::mutex requestMutex;
+    /* Request ids still in the interpreter pool and their frame sequences */
+    std::map<quint64, quint64> pipelineRequests;
+    detectionResult lastDetections;
+    std::unique_ptr<sceneChangeDetector> sceneDetector;
+    std::unique_ptr<objectTracker> tracker;
+    std::mutex trackerMutex;
+    detectionPool trackedPool;
+    std::atomic<int> lastInferenceTime;
+    std::thread preprocessThread;
+    std::thread renderThread;
+    std::atomic<bool> running;
+    std::atomic<quint64> framesSubmitted;
+    std::atomic<quint64> framesInferred;
+    std::atomic<quint64> framesTracked;
+    std::atomic<quint64> framesUnchanged;
+};
+
+#endif // DETECTIONPIPELINE_H
@@ -0,0 +1,51 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <atomic>
+
+#include "detectionresult.h"
+
+detectionPool::detectionPool(size_t maximumDetections) :
+    capacity(maximumDetections)
+{
+}
+
+std::shared_ptr<detectionList> detectionPool::acquire()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    std::shared_ptr<detectionList> list;
+
+    /* Lists are only copied out under the lock, so a count of one means no
+     * other reference can appear while the list is reused */
+    for (std::shared_ptr<detectionList> &pooledList : lists) {
+        if (pooledList.use_count() == 1) {
+            /* Order the last reader's accesses before the list is refilled */
+            std::atomic_thread_fence(std::memory_order_acquire);
+            pooledList->clear();
+            return pooledList;
+        }
+    }
+
+    list = std::make_shared<detectionList>();
+    list->reserve(capacity);
+
+    if (lists.size() < DETECTION_POOL_SIZE)
+        lists.push_back(list);
+
+    return list;
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef DETECTIONRESULT_H
+#define DETECTIONRESULT_H
+
+#define DETECTION_POOL_SIZE 8
+
+#include <QMetaType>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* One detected item, the box corners are normalised to the image size */
+struct detection {
+    int item;
+    float confidence;
+    float ymin;
+    float xmin;
+    float ymax;
+    float xmax;
+};
+
+typedef std::vector<detection> detectionList;
+
+/* Immutable once published, shared by every consumer without copying */
+typedef std::shared_ptr<const detectionList> detectionResult;
+
+Q_DECLARE_METATYPE(detectionResult)
+
+/*
+ * Hands out reusable detection lists. A list goes back into circulation once
+ * the pool holds the only reference to it, so after the first few results no
+ * memory is allocated. If every list is still in use a new one is created,
+ * and only kept if the pool has not reached DETECTION_POOL_SIZE
+ */
+class detectionPool
+{
+public:
+    explicit detectionPool(size_t maximumDetections);
+    std::shared_ptr<detectionList> acquire();
+
+private:
+    std::mutex poolMutex;
+    std::vector<std::shared_ptr<detectionList>> lists;
+    size_t capacity;
+};
+
+#endif // DETECTIONRESULT_H
@@ -0,0 +1,514 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "imagepreprocessor.h"
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PREPROCESS_NEON
+#elif defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#define PREPROCESS_X86
+#endif
+
+/*
+ * BT.601 limited range YUV to RGB coefficients in Q6 fixed point, matching
+ * cv::COLOR_YUV2RGB_UYVY. Every implementation below uses the same arithmetic
+ * so the output is identical whichever instruction set is selected
+ */
+#define YUV_Y_FACTOR 74
+#define YUV_RV_FACTOR 102
+#define YUV_GU_FACTOR 25
+#define YUV_GV_FACTOR 52
+#define YUV_BU_FACTOR 129
+
+typedef void (*blendRowFunction)(const uint8_t *top, const uint8_t *bottom,
+                                 uint8_t weight, uint8_t *output, size_t length);
+typedef void (*yuvToPlanarFunction)(const uint8_t *yuv, bool lumaFirst, int width,
+                                    uint8_t *red, uint8_t *green, uint8_t *blue);
+
+static inline uint8_t clampToByte(int value)
+{
+    return uint8_t(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+static inline void yuvToRgb(int luma, int u, int v, uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    int y = (luma - 16) * YUV_Y_FACTOR;
+
+    u -= 128;
+    v -= 128;
+
+    *red = clampToByte((y + YUV_RV_FACTOR * v + 32) >> 6);
+    *green = clampToByte((y - YUV_GU_FACTOR * u - YUV_GV_FACTOR * v + 32) >> 6);
+    *blue = clampToByte((y + YUV_BU_FACTOR * u + 32) >> 6);
+}
+
+/* Blend two rows, weight is the Q8 contribution of the bottom row (1-255) */
+static void blendRowScalar(const uint8_t *top, const uint8_t *bottom,
+                           uint8_t weight, uint8_t *output, size_t length)
+{
+    unsigned int topWeight = 256 - weight;
+
+    for (size_t i = 0; i < length; i++)
+        output[i] = uint8_t((top[i] * topWeight + bottom[i] * weight + 128) >> 8);
+}
+
+/* Convert packed YUV 4:2:2 into planar RGB, width must be even */
+static void yuvToPlanarScalar(const uint8_t *yuv, bool lumaFirst, int width,
+                              uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    int lumaOffset = lumaFirst ? 0 : 1;
+    int chromaOffset = lumaFirst ? 1 : 0;
+
+    for (int x = 0; x < width; x += 2, yuv += 4) {
+        int u = yuv[chromaOffset];
+        int v = yuv[chromaOffset + 2];
+
+        yuvToRgb(yuv[lumaOffset], u, v, &red[x], &green[x], &blue[x]);
+        yuvToRgb(yuv[lumaOffset + 2], u, v, &red[x + 1], &green[x + 1], &blue[x + 1]);
+    }
+}
+
+#if defined(PREPROCESS_NEON)
+static void blendRowNeon(const uint8_t *top, const uint8_t *bottom,
+                         uint8_t weight, uint8_t *output, size_t length)
+{
+    uint8x8_t topWeight = vdup_n_u8(uint8_t(256 - weight));
+    uint8x8_t bottomWeight = vdup_n_u8(weight);
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t a = vld1q_u8(top + i);
+        uint8x16_t b = vld1q_u8(bottom + i);
+        uint16x8_t low = vmlal_u8(vmull_u8(vget_low_u8(a), topWeight), vget_low_u8(b), bottomWeight);
+        uint16x8_t high = vmlal_u8(vmull_u8(vget_high_u8(a), topWeight), vget_high_u8(b), bottomWeight);
+
+        vst1q_u8(output + i, vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8)));
+    }
+
+    blendRowScalar(top + i, bottom + i, weight, output + i, length - i);
+}
+
+static void yuvToPlanarNeon(const uint8_t *yuv, bool lumaFirst, int width,
+                            uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16, yuv += 32) {
+        uint8x8x4_t pixels = vld4_u8(yuv);
+        uint8x8_t lumaEven = lumaFirst ? pixels.val[0] : pixels.val[1];
+        uint8x8_t lumaOdd = lumaFirst ? pixels.val[2] : pixels.val[3];
+        uint8x8_t chromaU = lumaFirst ? pixels.val[1] : pixels.val[0];
+        uint8x8_t chromaV = lumaFirst ? pixels.val[3] : pixels.val[2];
+        int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(chromaU, vdup_n_u8(128)));
+        int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(chromaV, vdup_n_u8(128)));
+        int16x8_t yEven = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(lumaEven, vdup_n_u8(16))), YUV_Y_FACTOR);
+        int16x8_t yOdd = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(lumaOdd, vdup_n_u8(16))), YUV_Y_FACTOR);
+        int16x8_t redChroma = vmulq_n_s16(v, YUV_RV_FACTOR);
+        int16x8_t greenChroma = vaddq_s16(vmulq_n_s16(u, YUV_GU_FACTOR), vmulq_n_s16(v, YUV_GV_FACTOR));
+        int16x8_t blueChroma = vmulq_n_s16(u, YUV_BU_FACTOR);
+        uint8x8x2_t r = vzip_u8(vqrshrun_n_s16(vqaddq_s16(yEven, redChroma), 6),
+                                vqrshrun_n_s16(vqaddq_s16(yOdd, redChroma), 6));
+        uint8x8x2_t g = vzip_u8(vqrshrun_n_s16(vqsubq_s16(yEven, greenChroma), 6),
+                                vqrshrun_n_s16(vqsubq_s16(yOdd, greenChroma), 6));
+        uint8x8x2_t b = vzip_u8(vqrshrun_n_s16(vqaddq_s16(yEven, blueChroma), 6),
+                                vqrshrun_n_s16(vqaddq_s16(yOdd, blueChroma), 6));
+
+        vst1q_u8(red + x, vcombine_u8(r.val[0], r.val[1]));
+        vst1q_u8(green + x, vcombine_u8(g.val[0], g.val[1]));
+        vst1q_u8(blue + x, vcombine_u8(b.val[0], b.val[1]));
+    }
+
+    yuvToPlanarScalar(yuv, lumaFirst, width - x, red + x, green + x, blue + x);
+}
+#endif
+
+#if defined(PREPROCESS_X86)
+static void blendRowSse2(const uint8_t *top, const uint8_t *bottom,
+                         uint8_t weight, uint8_t *output, size_t length)
+{
+    __m128i topWeight = _mm_set1_epi16(short(256 - weight));
+    __m128i bottomWeight = _mm_set1_epi16(weight);
+    __m128i rounding = _mm_set1_epi16(128);
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i));
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), topWeight),
+                                    _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), bottomWeight));
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), topWeight),
+                                     _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), bottomWeight));
+
+        low = _mm_srli_epi16(_mm_add_epi16(low, rounding), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, rounding), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(low, high));
+    }
+
+    blendRowScalar(top + i, bottom + i, weight, output + i, length - i);
+}
+
+/* Convert 8 pixels held in one 16 byte register into 16-bit R, G and B */
+static inline void yuvToRgbSse2(__m128i pixels, bool lumaFirst,
+                                __m128i *red, __m128i *green, __m128i *blue)
+{
+    __m128i byteMask = _mm_set1_epi16(0x00ff);
+    __m128i luma, chroma, u, v;
+
+    if (lumaFirst) {
+        luma = _mm_and_si128(pixels, byteMask);
+        chroma = _mm_srli_epi16(pixels, 8);
+    } else {
+        luma = _mm_srli_epi16(pixels, 8);
+        chroma = _mm_and_si128(pixels, byteMask);
+    }
+
+    chroma = _mm_sub_epi16(chroma, _mm_set1_epi16(128));
+    luma = _mm_mullo_epi16(_mm_sub_epi16(luma, _mm_set1_epi16(16)), _mm_set1_epi16(YUV_Y_FACTOR));
+
+    /* Chroma lanes alternate U and V, duplicate each one for its pixel pair */
+    u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(chroma, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(chroma, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+    *red = _mm_adds_epi16(luma, _mm_mullo_epi16(v, _mm_set1_epi16(YUV_RV_FACTOR)));
+    *green = _mm_subs_epi16(luma, _mm_add_epi16(_mm_mullo_epi16(u, _mm_set1_epi16(YUV_GU_FACTOR)),
+                                                _mm_mullo_epi16(v, _mm_set1_epi16(YUV_GV_FACTOR))));
+    *blue = _mm_adds_epi16(luma, _mm_mullo_epi16(u, _mm_set1_epi16(YUV_BU_FACTOR)));
+}
+
+static inline __m128i narrowSse2(__m128i low, __m128i high)
+{
+    __m128i rounding = _mm_set1_epi16(32);
+
+    low = _mm_srai_epi16(_mm_adds_epi16(low, rounding), 6);
+    high = _mm_srai_epi16(_mm_adds_epi16(high, rounding), 6);
+
+    return _mm_packus_epi16(low, high);
+}
+
+static void yuvToPlanarSse2(const uint8_t *yuv, bool lumaFirst, int width,
+                            uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16, yuv += 32) {
+        __m128i redLow, greenLow, blueLow, redHigh, greenHigh, blueHigh;
+
+        yuvToRgbSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(yuv)), lumaFirst,
+                     &redLow, &greenLow, &blueLow);
+        yuvToRgbSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(yuv + 16)), lumaFirst,
+                     &redHigh, &greenHigh, &blueHigh);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(red + x), narrowSse2(redLow, redHigh));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(green + x), narrowSse2(greenLow, greenHigh));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(blue + x), narrowSse2(blueLow, blueHigh));
+    }
+
+    yuvToPlanarScalar(yuv, lumaFirst, width - x, red + x, green + x, blue + x);
+}
+
+__attribute__((target("avx2")))
+static void blendRowAvx2(const uint8_t *top, const uint8_t *bottom,
+                         uint8_t weight, uint8_t *output, size_t length)
+{
+    __m256i topWeight = _mm256_set1_epi16(short(256 - weight));
+    __m256i bottomWeight = _mm256_set1_epi16(weight);
+    __m256i rounding = _mm256_set1_epi16(128);
+    __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    /* Unpacking and packing both work within 128-bit lanes, so the byte order
+     * is restored without a cross lane permute */
+    for (; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(top + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bottom + i));
+        __m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), topWeight),
+                                       _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), bottomWeight));
+        __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), topWeight),
+                                        _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), bottomWeight));
+
+        low = _mm256_srli_epi16(_mm256_add_epi16(low, rounding), 8);
+        high = _mm256_srli_epi16(_mm256_add_epi16(high, rounding), 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_packus_epi16(low, high));
+    }
+
+    blendRowSse2(top + i, bottom + i, weight, output + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static inline void yuvToRgbAvx2(__m256i pixels, bool lumaFirst,
+                                __m256i *red, __m256i *green, __m256i *blue)
+{
+    __m256i byteMask = _mm256_set1_epi16(0x00ff);
+    __m256i luma, chroma, u, v;
+
+    if (lumaFirst) {
+        luma = _mm256_and_si256(pixels, byteMask);
+        chroma = _mm256_srli_epi16(pixels, 8);
+    } else {
+        luma = _mm256_srli_epi16(pixels, 8);
+        chroma = _mm256_and_si256(pixels, byteMask);
+    }
+
+    chroma = _mm256_sub_epi16(chroma, _mm256_set1_epi16(128));
+    luma = _mm256_mullo_epi16(_mm256_sub_epi16(luma, _mm256_set1_epi16(16)), _mm256_set1_epi16(YUV_Y_FACTOR));
+
+    u = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(chroma, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    v = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(chroma, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+    *red = _mm256_adds_epi16(luma, _mm256_mullo_epi16(v, _mm256_set1_epi16(YUV_RV_FACTOR)));
+    *green = _mm256_subs_epi16(luma, _mm256_add_epi16(_mm256_mullo_epi16(u, _mm256_set1_epi16(YUV_GU_FACTOR)),
+                                                      _mm256_mullo_epi16(v, _mm256_set1_epi16(YUV_GV_FACTOR))));
+    *blue = _mm256_adds_epi16(luma, _mm256_mullo_epi16(u, _mm256_set1_epi16(YUV_BU_FACTOR)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i narrowAvx2(__m256i low, __m256i high)
+{
+    __m256i rounding = _mm256_set1_epi16(32);
+
+    low = _mm256_srai_epi16(_mm256_adds_epi16(low, rounding), 6);
+    high = _mm256_srai_epi16(_mm256_adds_epi16(high, rounding), 6);
+
+    /* packus interleaves the 128-bit lanes of its inputs, put them back in order */
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+__attribute__((target("avx2")))
+static void yuvToPlanarAvx2(const uint8_t *yuv, bool lumaFirst, int width,
+                            uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    int x = 0;
+
+    for (; x + 32 <= width; x += 32, yuv += 64) {
+        __m256i redLow, greenLow, blueLow, redHigh, greenHigh, blueHigh;
+
+        yuvToRgbAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(yuv)), lumaFirst,
+                     &redLow, &greenLow, &blueLow);
+        yuvToRgbAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(yuv + 32)), lumaFirst,
+                     &redHigh, &greenHigh, &blueHigh);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(red + x), narrowAvx2(redLow, redHigh));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(green + x), narrowAvx2(greenLow, greenHigh));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(blue + x), narrowAvx2(blueLow, blueHigh));
+    }
+
+    yuvToPlanarSse2(yuv, lumaFirst, width - x, red + x, green + x, blue + x);
+}
+#endif
+
+struct preprocessKernels {
+    blendRowFunction blendRow;
+    yuvToPlanarFunction yuvToPlanar;
+    const char *name;
+};
+
+/* Pick the widest implementation supported by the CPU we are running on */
+static preprocessKernels selectKernels()
+{
+#if defined(PREPROCESS_NEON)
+    return { blendRowNeon, yuvToPlanarNeon, "NEON" };
+#elif defined(PREPROCESS_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return { blendRowAvx2, yuvToPlanarAvx2, "AVX2" };
+
+    return { blendRowSse2, yuvToPlanarSse2, "SSE2" };
+#else
+    return { blendRowScalar, yuvToPlanarScalar, "Scalar" };
+#endif
+}
+
+static const preprocessKernels kernels = selectKernels();
+
+imagePreprocessor::imagePreprocessor()
+{
+    tableSourceWidth = 0;
+    tableSourceHeight = 0;
+    tableDestinationWidth = 0;
+    tableDestinationHeight = 0;
+}
+
+const char* imagePreprocessor::getInstructionSet()
+{
+    return kernels.name;
+}
+
+/*
+ * Build the sampling tables for bilinear scaling using pixel centre alignment,
+ * the same mapping as cv::resize with cv::INTER_LINEAR. Each output coordinate
+ * stores its two source neighbours and the Q8 weight of the second one
+ */
+static void buildAxisTable(int sourceSize, int destinationSize,
+                           std::vector<int> &index, std::vector<uint8_t> &weight)
+{
+    double scale = double(sourceSize) / destinationSize;
+
+    index.resize(size_t(destinationSize) * 2);
+    weight.resize(size_t(destinationSize));
+
+    for (int i = 0; i < destinationSize; i++) {
+        double position = (i + 0.5) * scale - 0.5;
+        int first = int(floor(position));
+        int fraction = int(lround((position - first) * 256));
+
+        if (fraction == 256) {
+            first++;
+            fraction = 0;
+        }
+
+        if (first < 0) {
+            first = 0;
+            fraction = 0;
+        } else if (first >= sourceSize - 1) {
+            first = sourceSize - 1;
+            fraction = 0;
+        }
+
+        index[size_t(i) * 2] = first;
+        index[size_t(i) * 2 + 1] = first < sourceSize - 1 ? first + 1 : first;
+        weight[size_t(i)] = uint8_t(fraction);
+    }
+}
+
+void imagePreprocessor::updateTables(int sourceWidth, int sourceHeight,
+                                     int destinationWidth, int destinationHeight)
+{
+    if (sourceWidth == tableSourceWidth && sourceHeight == tableSourceHeight &&
+        destinationWidth == tableDestinationWidth && destinationHeight == tableDestinationHeight)
+        return;
+
+    buildAxisTable(sourceWidth, destinationWidth, xIndex, xWeight);
+    buildAxisTable(sourceHeight, destinationHeight, yIndex, yWeight);
+
+    blendedRow.resize(size_t(sourceWidth) * 3);
+    redRow.resize(size_t(sourceWidth));
+    greenRow.resize(size_t(sourceWidth));
+    blueRow.resize(size_t(sourceWidth));
+
+    tableSourceWidth = sourceWidth;
+    tableSourceHeight = sourceHeight;
+    tableDestinationWidth = destinationWidth;
+    tableDestinationHeight = destinationHeight;
+}
+
+tensorEncoding::tensorEncoding() :
+    type(TENSOR_TYPE_UINT8)
+{
+    memset(int8Table, 0, sizeof(int8Table));
+    memset(floatTable, 0, sizeof(floatTable));
+}
+
+tensorEncoding::tensorEncoding(tensorType tensor, float mean, float deviation, float scale, int zeroPoint) :
+    type(tensor)
+{
+    for (int pixel = 0; pixel < 256; pixel++) {
+        float value = (pixel - mean) / deviation;
+        long quantised = lroundf(value / scale) + zeroPoint;
+
+        floatTable[pixel] = value;
+        int8Table[pixel] = int8_t(quantised < -128 ? -128 : (quantised > 127 ? 127 : quantised));
+    }
+}
+
+size_t tensorEncoding::getElementSize() const
+{
+    return type == TENSOR_TYPE_FLOAT32 ? sizeof(float) : sizeof(uint8_t);
+}
+
+/*
+ * Produce one interleaved RGB output row by sampling the three channel rows
+ * horizontally. The channels are either planar (pixelStride 1) or interleaved
+ * in a single row (pixelStride 3). Without a table the sampled bytes are
+ * stored as they are, otherwise each is encoded through it
+ */
+template <typename T>
+static void sampleRow(const uint8_t *channels[3], int pixelStride, const int *index,
+                      const uint8_t *weight, int width, const T *table, T *output)
+{
+    for (int x = 0; x < width; x++, output += 3) {
+        int first = index[x * 2] * pixelStride;
+        int second = index[x * 2 + 1] * pixelStride;
+        unsigned int secondWeight = weight[x];
+        unsigned int firstWeight = 256 - secondWeight;
+
+        for (int channel = 0; channel < 3; channel++) {
+            uint8_t value = uint8_t((channels[channel][first] * firstWeight +
+                                     channels[channel][second] * secondWeight + 128) >> 8);
+
+            output[channel] = table == nullptr ? T(value) : table[value];
+        }
+    }
+}
+
+static void sampleRow(const uint8_t *channels[3], int pixelStride, const int *index, const uint8_t *weight,
+                      int width, const tensorEncoding *encoding, void *output)
+{
+    if (encoding == nullptr || encoding->type == TENSOR_TYPE_UINT8)
+        sampleRow<uint8_t>(channels, pixelStride, index, weight, width, nullptr, static_cast<uint8_t*>(output));
+    else if (encoding->type == TENSOR_TYPE_INT8)
+        sampleRow(channels, pixelStride, index, weight, width, encoding->int8Table, static_cast<int8_t*>(output));
+    else
+        sampleRow(channels, pixelStride, index, weight, width, encoding->floatTable, static_cast<float*>(output));
+}
+
+void imagePreprocessor::process(const uint8_t *source, size_t sourceStride, pixelFormat format,
+                                int sourceWidth, int sourceHeight,
+                                void *destination, int destinationWidth, int destinationHeight,
+                                const tensorEncoding *encoding)
+{
+    size_t rowBytes = size_t(sourceWidth) * (format == PIXEL_FORMAT_RGB888 ? 3 : 2);
+    size_t outputRowBytes = size_t(destinationWidth) * 3 * (encoding ? encoding->getElementSize() : 1);
+
+    updateTables(sourceWidth, sourceHeight, destinationWidth, destinationHeight);
+
+    for (int y = 0; y < destinationHeight; y++) {
+        const uint8_t *top = source + sourceStride * size_t(yIndex[size_t(y) * 2]);
+        const uint8_t *bottom = source + sourceStride * size_t(yIndex[size_t(y) * 2 + 1]);
+        const uint8_t *row = top;
+        const uint8_t *channels[3];
+        void *output = static_cast<uint8_t*>(destination) + size_t(y) * outputRowBytes;
+
+        /* Blending in YUV is equivalent to blending in RGB as the colour
+         * conversion is affine, so only one row needs converting */
+        if (yWeight[size_t(y)] != 0) {
+            kernels.blendRow(top, bottom, yWeight[size_t(y)], blendedRow.data(), rowBytes);
+            row = blendedRow.data();
+        }
+
+        if (format == PIXEL_FORMAT_RGB888) {
+            channels[0] = row;
+            channels[1] = row + 1;
+            channels[2] = row + 2;
+            sampleRow(channels, 3, xIndex.data(), xWeight.data(), destinationWidth, encoding, output);
+        } else {
+            kernels.yuvToPlanar(row, format == PIXEL_FORMAT_YUYV, sourceWidth,
+                                redRow.data(), greenRow.data(), blueRow.data());
+            channels[0] = redRow.data();
+            channels[1] = greenRow.data();
+            channels[2] = blueRow.data();
+            sampleRow(channels, 1, xIndex.data(), xWeight.data(), destinationWidth, encoding, output);
+        }
+    }
+}
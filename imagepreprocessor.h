@@ -0,0 +1,76 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef IMAGEPREPROCESSOR_H
+#define IMAGEPREPROCESSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+enum pixelFormat { PIXEL_FORMAT_RGB888, PIXEL_FORMAT_UYVY, PIXEL_FORMAT_YUYV };
+enum tensorType { TENSOR_TYPE_UINT8, TENSOR_TYPE_INT8, TENSOR_TYPE_FLOAT32 };
+
+/*
+ * How the 8-bit pixel values are stored in the input tensor. uint8 tensors
+ * take the pixels unchanged, as their quantisation already describes the
+ * model's normalisation. int8 and float32 tensors go through a table of all
+ * 256 values, built once from the mean and deviation the model expects and,
+ * for int8, the tensor's scale and zero point
+ */
+struct tensorEncoding {
+    tensorEncoding();
+    tensorEncoding(tensorType tensor, float mean, float deviation, float scale, int zeroPoint);
+    size_t getElementSize() const;
+
+    tensorType type;
+    int8_t int8Table[256];
+    float floatTable[256];
+};
+
+/*
+ * Converts a camera frame to RGB, bilinearly scales it and writes the result
+ * straight into an interleaved RGB input tensor in a single pass, encoded
+ * for the tensor's type as each value is stored.
+ * Each output row is built from two vertically blended source rows, which are
+ * colour converted into small row buffers before being sampled horizontally,
+ * so no full size intermediate frame is ever produced
+ */
+class imagePreprocessor
+{
+public:
+    imagePreprocessor();
+    void process(const uint8_t *source, size_t sourceStride, pixelFormat format,
+                 int sourceWidth, int sourceHeight,
+                 void *destination, int destinationWidth, int destinationHeight,
+                 const tensorEncoding *encoding = nullptr);
+    static const char* getInstructionSet();
+
+private:
+    void updateTables(int sourceWidth, int sourceHeight, int destinationWidth, int destinationHeight);
+
+    int tableSourceWidth, tableSourceHeight;
+    int tableDestinationWidth, tableDestinationHeight;
+    std::vector<int> xIndex, yIndex;
+    std::vector<uint8_t> xWeight, yWeight;
+    std::vector<uint8_t> blendedRow;
+    std::vector<uint8_t> redRow, greenRow, blueRow;
+};
+
+#endif // IMAGEPREPROCESSOR_H
@@ -0,0 +1,73 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+
+#include <turbojpeg.h>
+
+#include "jpegdecoder.h"
+
+jpegDecoder::jpegDecoder()
+{
+    handle = tjInitDecompress();
+
+    if (handle == nullptr)
+        qWarning() << "Could not create the JPEG decoder:" << tjGetErrorStr();
+}
+
+jpegDecoder::~jpegDecoder()
+{
+    if (handle != nullptr)
+        tjDestroy(handle);
+}
+
+/*
+ * Decode a frame at 1/scale of its size into an RGB image, reusing the image's
+ * buffer when the size has not changed. The fast DCT and upsampling are used,
+ * as any loss of precision is well below what the model can see
+ */
+bool jpegDecoder::decode(const uint8_t *data, size_t size, int scale, cv::Mat &image)
+{
+    tjscalingfactor factor = {1, scale};
+    int width, height, subsampling, colourspace;
+    int scaledWidth, scaledHeight;
+
+    if (handle == nullptr)
+        return false;
+
+    if (tjDecompressHeader3(handle, data, (unsigned long)size, &width, &height,
+                            &subsampling, &colourspace) == -1) {
+        qWarning() << "Could not read the JPEG header:" << tjGetErrorStr2(handle);
+        return false;
+    }
+
+    scaledWidth = TJSCALED(width, factor);
+    scaledHeight = TJSCALED(height, factor);
+    image.create(scaledHeight, scaledWidth, CV_8UC3);
+
+    /* Corrupt frames from the camera are reported as warnings by libjpeg-turbo
+     * and still produce an image, only fatal errors drop the frame */
+    if (tjDecompress2(handle, data, (unsigned long)size, image.data, scaledWidth, int(image.step),
+                      scaledHeight, TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) == -1 &&
+        tjGetErrorCode(handle) == TJERR_FATAL) {
+        qWarning() << "Could not decode the JPEG frame:" << tjGetErrorStr2(handle);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,43 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef JPEGDECODER_H
+#define JPEGDECODER_H
+
+#include <opencv2/core.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Decodes MJPEG camera frames with libjpeg-turbo straight into RGB. Frames can
+ * be decoded at 1/2, 1/4 or 1/8 of their size, which skips most of the inverse
+ * DCT work and is far cheaper than decoding in full and scaling afterwards
+ */
+class jpegDecoder
+{
+public:
+    jpegDecoder();
+    ~jpegDecoder();
+    bool decode(const uint8_t *data, size_t size, int scale, cv::Mat &image);
+
+private:
+    void *handle;
+};
+
+#endif // JPEGDECODER_H
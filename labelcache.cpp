@@ -0,0 +1,57 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QPainter>
+
+#include "labelcache.h"
+#include "mainwindow.h"
+
+void labelCache::setLabels(const QStringList &labels)
+{
+    labelList = labels;
+    labelImages.clear();
+}
+
+const QImage& labelCache::getLabel(int item, float confidence)
+{
+    int percent = qBound(0, qRound(confidence * 100), LABEL_SCORE_BUCKETS - 1);
+    int key = item * LABEL_SCORE_BUCKETS + percent;
+    QHash<int, QImage>::iterator label = labelImages.find(key);
+
+    if (label == labelImages.end()) {
+        QString text = labelList.value(item) + QString(" %1%").arg(percent);
+        QFont font;
+        QImage image;
+        QPainter painter;
+
+        font.setPixelSize(LABEL_FONT_PIXEL_SIZE);
+        image = QImage(QFontMetrics(font).size(Qt::TextSingleLine, text), QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::black);
+        painter.begin(&image);
+        painter.setFont(font);
+        painter.setPen(TEXT_COLOUR);
+        painter.drawText(image.rect(), Qt::AlignLeft | Qt::AlignTop, text);
+        painter.end();
+
+        label = labelImages.insert(key, image);
+    }
+
+    return label.value();
+}
@@ -0,0 +1,46 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+#ifndef LABELCACHE_H
+#define LABELCACHE_H
+
+#define LABEL_FONT_PIXEL_SIZE 24
+#define LABEL_SCORE_BUCKETS 101
+
+#include <QHash>
+#include <QImage>
+#include <QStringList>
+
+/*
+ * Pre-rendered detection labels, the item name and its score in whole
+ * percent over a black background. Each label is laid out and drawn once, the
+ * first time its item and score are seen, and then only needs blitting.
+ * Images rather than pixmaps are kept so a cache can live on any thread, but
+ * a cache must only be used from one thread
+ */
+class labelCache
+{
+public:
+    void setLabels(const QStringList &labels);
+    const QImage& getLabel(int item, float confidence);
+
+private:
+    QStringList labelList;
+    QHash<int, QImage> labelImages;
+};
+
+#endif // LABELCACHE_H
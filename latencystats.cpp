@@ -0,0 +1,317 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <cmath>
+#include <limits>
+#include <stdlib.h>
+
+#include "latencystats.h"
+
+static const char* const stageNames[STAGE_COUNT] = {
+    "capture",
+    "jpeg_decode",
+    "colour_conversion",
+    "scene_change",
+    "preprocess",
+    "input_copy",
+    "invoke",
+    "output_parse",
+    "postprocess",
+    "request",
+    "overlay_render",
+    "mat_to_qimage",
+    "scene_redraw"
+};
+
+static const char* const counterNames[COUNTER_COUNT] = {
+    "scene_checked_frames",
+    "scene_skipped_frames",
+    "scene_saved_us",
+    "display_shown_frames",
+    "display_dropped_frames"
+};
+
+latencyStats::latencyStats()
+{
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+            histograms[stage].buckets[i] = 0;
+
+        histograms[stage].count = 0;
+        histograms[stage].total = 0;
+        histograms[stage].minimum = std::numeric_limits<quint64>::max();
+        histograms[stage].maximum = 0;
+
+        lastSummary[stage].buckets.assign(LATENCY_BUCKETS, 0);
+        lastSummary[stage].count = 0;
+        lastSummary[stage].total = 0;
+    }
+
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        counters[counter] = 0;
+        lastCounters[counter] = 0;
+    }
+}
+
+latencyStats& latencyStats::instance()
+{
+    static latencyStats stats;
+
+    return stats;
+}
+
+/*
+ * Values below 2 * LATENCY_SUB_BUCKETS get a bucket each, above that every
+ * power of two is split into LATENCY_SUB_BUCKETS equal buckets
+ */
+int latencyStats::getBucketIndex(quint64 value)
+{
+    int shift;
+
+    if (value >= (quint64(1) << LATENCY_MAX_BITS))
+        value = (quint64(1) << LATENCY_MAX_BITS) - 1;
+
+    if (value < LATENCY_SUB_BUCKETS)
+        return int(value);
+
+    shift = (63 - __builtin_clzll(value)) - LATENCY_SUB_BUCKET_BITS;
+
+    return (shift + 1) * LATENCY_SUB_BUCKETS + int(value >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+quint64 latencyStats::getBucketLowest(int index)
+{
+    int shift = index / LATENCY_SUB_BUCKETS - 1;
+
+    if (shift <= 0)
+        return quint64(index);
+
+    return quint64(index - shift * LATENCY_SUB_BUCKETS) << shift;
+}
+
+void latencyStats::record(latencyStage stage, quint64 microseconds)
+{
+    histogram &stageHistogram = histograms[stage];
+    quint64 current;
+
+    stageHistogram.buckets[getBucketIndex(microseconds)].fetch_add(1, std::memory_order_relaxed);
+    stageHistogram.count.fetch_add(1, std::memory_order_relaxed);
+    stageHistogram.total.fetch_add(microseconds, std::memory_order_relaxed);
+
+    current = stageHistogram.minimum.load(std::memory_order_relaxed);
+    while (microseconds < current &&
+           !stageHistogram.minimum.compare_exchange_weak(current, microseconds, std::memory_order_relaxed));
+
+    current = stageHistogram.maximum.load(std::memory_order_relaxed);
+    while (microseconds > current &&
+           !stageHistogram.maximum.compare_exchange_weak(current, microseconds, std::memory_order_relaxed));
+}
+
+void latencyStats::increment(statCounter counter, quint64 amount)
+{
+    counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+/* Mean over the whole run in microseconds, 0 if nothing was recorded */
+quint64 latencyStats::getMean(latencyStage stage)
+{
+    quint64 count = histograms[stage].count.load(std::memory_order_relaxed);
+
+    return count > 0 ? histograms[stage].total.load(std::memory_order_relaxed) / count : 0;
+}
+
+latencyStats::histogramSnapshot latencyStats::takeSnapshot(latencyStage stage)
+{
+    histogramSnapshot snapshot;
+
+    snapshot.buckets.resize(LATENCY_BUCKETS);
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+        snapshot.buckets[i] = histograms[stage].buckets[i].load(std::memory_order_relaxed);
+
+    snapshot.count = histograms[stage].count.load(std::memory_order_relaxed);
+    snapshot.total = histograms[stage].total.load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+/* Return the highest value that falls in the bucket holding the percentile */
+quint64 latencyStats::getPercentile(const histogramSnapshot &snapshot, double percentile)
+{
+    quint64 target = quint64(std::ceil(percentile / 100.0 * snapshot.count));
+    quint64 seen = 0;
+
+    if (target == 0)
+        target = 1;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += snapshot.buckets[i];
+
+        if (seen >= target)
+            return getBucketLowest(i + 1) - 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Summarise each stage over the interval since the previous call, used by the
+ * on-screen overlay so it follows the current behaviour rather than the whole
+ * run
+ */
+QString latencyStats::getSummary()
+{
+    std::lock_guard<std::mutex> lock(summaryMutex);
+    QString summary;
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        histogramSnapshot current = takeSnapshot(latencyStage(stage));
+        histogramSnapshot interval = current;
+
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+            interval.buckets[i] -= lastSummary[stage].buckets[i];
+
+        interval.count -= lastSummary[stage].count;
+        interval.total -= lastSummary[stage].total;
+        lastSummary[stage] = current;
+
+        /* Bucket counts can land just after count was read */
+        if (interval.count == 0)
+            continue;
+
+        summary += QString("%1 mean %2 p50 %3 p99 %4 ms\n").arg(stageNames[stage], -18)
+                   .arg(interval.total / 1000.0 / interval.count, 0, 'f', 2)
+                   .arg(getPercentile(interval, 50) / 1000.0, 0, 'f', 2)
+                   .arg(getPercentile(interval, 99) / 1000.0, 0, 'f', 2);
+    }
+
+    quint64 checked = counters[COUNTER_SCENE_CHECKED] - lastCounters[COUNTER_SCENE_CHECKED];
+    quint64 skipped = counters[COUNTER_SCENE_SKIPPED] - lastCounters[COUNTER_SCENE_SKIPPED];
+    quint64 saved = counters[COUNTER_SCENE_SAVED_US] - lastCounters[COUNTER_SCENE_SAVED_US];
+    quint64 shown = counters[COUNTER_DISPLAY_SHOWN] - lastCounters[COUNTER_DISPLAY_SHOWN];
+    quint64 dropped = counters[COUNTER_DISPLAY_DROPPED] - lastCounters[COUNTER_DISPLAY_DROPPED];
+
+    for (int counter = 0; counter < COUNTER_COUNT; counter++)
+        lastCounters[counter] = counters[counter].load();
+
+    if (checked > 0)
+        summary += QString("%1 skipped %2 of %3 frames, saved %4 ms\n").arg("scene_unchanged", -18)
+                   .arg(skipped).arg(checked).arg(saved / 1000.0, 0, 'f', 1);
+
+    if (shown > 0 || dropped > 0)
+        summary += QString("%1 shown %2, dropped %3 frames\n").arg("display", -18).arg(shown).arg(dropped);
+
+    return summary.trimmed();
+}
+
+/* Write every histogram to a file, as CSV if the name ends in .csv or else JSON */
+bool latencyStats::exportStatistics(const QString &fileName)
+{
+    QFile file(fileName);
+    bool csv = QFileInfo(fileName).suffix().toLower() == "csv";
+    QJsonArray stages;
+    QTextStream stream(&file);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Could not write latency statistics to" << fileName;
+        return false;
+    }
+
+    if (csv)
+        stream << "stage,count,mean_us,min_us,p50_us,p90_us,p99_us,p999_us,max_us\n";
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        histogramSnapshot snapshot = takeSnapshot(latencyStage(stage));
+        quint64 minimum = snapshot.count > 0 ? histograms[stage].minimum.load() : 0;
+        quint64 maximum = histograms[stage].maximum.load();
+        double mean = snapshot.count > 0 ? double(snapshot.total) / snapshot.count : 0;
+
+        if (csv) {
+            stream << stageNames[stage] << "," << snapshot.count << "," << mean << "," << minimum << ","
+                   << getPercentile(snapshot, 50) << "," << getPercentile(snapshot, 90) << ","
+                   << getPercentile(snapshot, 99) << "," << getPercentile(snapshot, 99.9) << ","
+                   << maximum << "\n";
+        } else {
+            QJsonObject stageObject;
+            QJsonArray buckets;
+
+            /* Only the occupied buckets, as [lowest value, count] pairs */
+            for (int i = 0; i < LATENCY_BUCKETS; i++) {
+                if (snapshot.buckets[i] > 0)
+                    buckets.append(QJsonArray({double(getBucketLowest(i)), double(snapshot.buckets[i])}));
+            }
+
+            stageObject["stage"] = stageNames[stage];
+            stageObject["count"] = double(snapshot.count);
+            stageObject["mean_us"] = mean;
+            stageObject["min_us"] = double(minimum);
+            stageObject["p50_us"] = double(getPercentile(snapshot, 50));
+            stageObject["p90_us"] = double(getPercentile(snapshot, 90));
+            stageObject["p99_us"] = double(getPercentile(snapshot, 99));
+            stageObject["p999_us"] = double(getPercentile(snapshot, 99.9));
+            stageObject["max_us"] = double(maximum);
+            stageObject["buckets"] = buckets;
+            stages.append(stageObject);
+        }
+    }
+
+    /* Counters go in the count column of the CSV */
+    if (csv) {
+        for (int counter = 0; counter < COUNTER_COUNT; counter++)
+            stream << counterNames[counter] << "," << counters[counter].load() << ",,,,,,,\n";
+    }
+
+    if (!csv) {
+        QJsonObject report;
+        QJsonObject counterObject;
+
+        for (int counter = 0; counter < COUNTER_COUNT; counter++)
+            counterObject[counterNames[counter]] = double(counters[counter].load());
+
+        report["stages"] = stages;
+        report["counters"] = counterObject;
+        stream << QJsonDocument(report).toJson();
+    }
+
+    return true;
+}
+
+/* Export when the application exits, including through exit() on errors */
+void latencyStats::exportOnExit(const QString &fileName)
+{
+    if (exitFileName.isEmpty())
+        atexit(exitHandler);
+
+    exitFileName = fileName;
+}
+
+void latencyStats::exitHandler()
+{
+    latencyStats &stats = instance();
+
+    if (stats.exportStatistics(stats.exitFileName))
+        qInfo() << "Latency statistics written to" << stats.exitFileName;
+}
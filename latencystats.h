@@ -0,0 +1,128 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+/* Log-linear buckets, 16 per power of two up to 2^32 us, roughly 6% precision */
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_BITS 32
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+enum latencyStage {
+    STAGE_CAPTURE,
+    STAGE_JPEG_DECODE,
+    STAGE_COLOUR_CONVERSION,
+    STAGE_SCENE_CHANGE,
+    STAGE_PREPROCESS,
+    STAGE_INPUT_COPY,
+    STAGE_INVOKE,
+    STAGE_OUTPUT_PARSE,
+    STAGE_POSTPROCESS,
+    STAGE_REQUEST,
+    STAGE_OVERLAY_RENDER,
+    STAGE_MAT_TO_QIMAGE,
+    STAGE_SCENE_REDRAW,
+    STAGE_COUNT
+};
+
+/* Event totals kept next to the histograms */
+enum statCounter {
+    COUNTER_SCENE_CHECKED,
+    COUNTER_SCENE_SKIPPED,
+    COUNTER_SCENE_SAVED_US,
+    COUNTER_DISPLAY_SHOWN,
+    COUNTER_DISPLAY_DROPPED,
+    COUNTER_COUNT
+};
+
+/*
+ * Collects the time spent in each stage of the application into histograms.
+ * Recording is lock free and only touches a few atomic counters, so it stays
+ * enabled on every frame. The histograms can be exported as CSV or JSON and
+ * summarised over the interval since the last summary for the stats overlay,
+ * along with a few event counters
+ */
+class latencyStats
+{
+public:
+    static latencyStats& instance();
+    void record(latencyStage stage, quint64 microseconds);
+    void increment(statCounter counter, quint64 amount = 1);
+    quint64 getMean(latencyStage stage);
+    QString getSummary();
+    bool exportStatistics(const QString &fileName);
+    void exportOnExit(const QString &fileName);
+
+private:
+    struct histogram {
+        std::atomic<quint64> buckets[LATENCY_BUCKETS];
+        std::atomic<quint64> count;
+        std::atomic<quint64> total;
+        std::atomic<quint64> minimum;
+        std::atomic<quint64> maximum;
+    };
+
+    struct histogramSnapshot {
+        std::vector<quint64> buckets;
+        quint64 count;
+        quint64 total;
+    };
+
+    latencyStats();
+    histogramSnapshot takeSnapshot(latencyStage stage);
+    static quint64 getPercentile(const histogramSnapshot &snapshot, double percentile);
+    static int getBucketIndex(quint64 value);
+    static quint64 getBucketLowest(int index);
+    static void exitHandler();
+
+    histogram histograms[STAGE_COUNT];
+    std::atomic<quint64> counters[COUNTER_COUNT];
+    std::mutex summaryMutex;
+    histogramSnapshot lastSummary[STAGE_COUNT];
+    quint64 lastCounters[COUNTER_COUNT];
+    QString exitFileName;
+};
+
+/* Records the time from construction to destruction against a stage */
+class stageTimer
+{
+public:
+    explicit stageTimer(latencyStage timedStage) :
+        stage(timedStage), startTime(std::chrono::steady_clock::now()) {}
+
+    ~stageTimer()
+    {
+        latencyStats::instance().record(stage, quint64(std::chrono::duration_cast<std::chrono::microseconds>(
+                                        std::chrono::steady_clock::now() - startTime).count()));
+    }
+
+private:
+    latencyStage stage;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif // LATENCYSTATS_H
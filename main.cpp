@@ -18,15 +18,155 @@
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QDir>
 #include <QFile>
+#include <QStandardPaths>
 
+#include "benchmark.h"
+#include "latencystats.h"
 #include "mainwindow.h"
+#include "startuptimeline.h"
+
+/* Benchmarks run without a display, so they only need a QCoreApplication */
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (QString(argv[i]).startsWith("--preprocess-benchmark") ||
+            QString(argv[i]).startsWith("--benchmark"))
+            return true;
+    }
+
+    return false;
+}
+
+/* Parse the --format, --resolution, --fps and --jpeg-scale options */
+static captureSettings parseCaptureSettings(const QString &format, const QString &resolution,
+                                            const QString &frameRate, const QString &jpegScale)
+{
+    captureSettings settings;
+    QStringList size = resolution.toLower().split('x');
+
+    if (format == "uyvy")
+        settings.format = CAPTURE_FORMAT_UYVY;
+    else if (format == "yuyv")
+        settings.format = CAPTURE_FORMAT_YUYV;
+    else if (format == "mjpeg")
+        settings.format = CAPTURE_FORMAT_MJPEG;
+    else
+        qFatal("Unknown capture format %s", format.toStdString().c_str());
+
+    settings.width = 0;
+    settings.height = 0;
+
+    if (!resolution.isEmpty()) {
+        if (size.size() != 2 || size.first().toInt() <= 0 || size.last().toInt() <= 0)
+            qFatal("Resolution must be given as WIDTHxHEIGHT, e.g. 1280x720");
+
+        settings.width = size.first().toInt();
+        settings.height = size.last().toInt();
+    }
+
+    settings.frameRate = frameRate.toInt();
+    settings.jpegScale = jpegScale.toInt();
+
+    if (settings.jpegScale != 1 && settings.jpegScale != 2 && settings.jpegScale != 4 && settings.jpegScale != 8)
+        qFatal("JPEG scale must be 1, 2, 4 or 8");
+
+    return settings;
+}
+
+/* Parse a CPU list such as "0-3,5" into the CPU numbers it names */
+static QVector<int> parseCpuList(const QString &cpuList)
+{
+    QVector<int> cpus;
+
+    for (const QString &range : cpuList.split(',', QString::SkipEmptyParts)) {
+        QStringList bounds = range.split('-');
+        int first = bounds.first().toInt();
+        int last = bounds.last().toInt();
+
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.append(cpu);
+    }
+
+    return cpus;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    startupTimeline::instance().mark("main", "Application started");
+
+    QScopedPointer<QCoreApplication> a(isHeadless(argc, argv) ? new QCoreApplication(argc, argv)
+                                                              : new QApplication(argc, argv));
     QCommandLineParser parser;
     QCommandLineOption cameraOption(QStringList() << "c" << "camera", "Choose a camera.", "file");
+    QCommandLineOption v4l2Option("v4l2", "Capture through the native V4L2 backend instead of OpenCV.");
+    QCommandLineOption formatOption("format",
+            "Capture format: uyvy, yuyv or mjpeg, MIPI cameras only support uyvy (default uyvy).",
+            "format", "uyvy");
+    QCommandLineOption resolutionOption("resolution",
+            "Capture resolution, e.g. 1280x720 (default 800x600 MIPI, 1280x720 USB).", "size");
+    QCommandLineOption fpsOption("fps",
+            "Capture frame rate (default 10 on USB, the sensor's rate on MIPI).", "fps");
+    QCommandLineOption jpegScaleOption("jpeg-scale",
+            "Decode MJPEG frames at 1/1, 1/2, 1/4 or 1/8 of their size (default 1).", "divisor", "1");
+    QCommandLineOption liveOption("live", "Start with live detection enabled.");
+    QCommandLineOption preprocessBenchmarkOption("preprocess-benchmark",
+            "Time the preprocessing kernels against OpenCV and exit.", "iterations");
+    QCommandLineOption interpretersOption("interpreters",
+            "Number of interpreters sharing the model (default 1).", "count", "1");
+    QCommandLineOption cpuSetsOption("cpu-sets",
+            "CPUs to pin each interpreter to, e.g. \"4-5;0-3\".", "sets");
+    QCommandLineOption benchmarkOption("benchmark",
+            "Run inference over a directory of images or a video file, print the results as JSON and exit.",
+            "path");
+    QCommandLineOption iterationsOption("iterations",
+            "Number of timed inferences for --benchmark (default 100).", "count", "100");
+    QCommandLineOption warmupOption("warmup",
+            "Number of untimed inferences run first for --benchmark (default 10).", "count", "10");
+    QCommandLineOption delegateOption("delegate",
+            "Inference delegate: tflite (none), armnn (Arm) or xnnpack (x86). --benchmark also "
+            "accepts both to compare tflite with the delegate (default both).", "name", "both");
+    QCommandLineOption statsOption("stats",
+            "Write per-stage latency histograms to a CSV or JSON file on exit.", "file");
+    QCommandLineOption trackOption("track",
+            "In live detection, track the boxes between detector runs and run the detector at most every "
+            "given number of frames.", "frames");
+    QCommandLineOption sceneThresholdOption("scene-threshold",
+            "In live detection, skip inference on frames whose mean luma differs from the last inferred "
+            "frame by less than this many levels.", "levels");
+    QCommandLineOption startupLogOption("startup-log",
+            "File the startup timeline is written to, empty to disable (default "
+            "shopping-basket-demo-startup.log in the temporary directory).", "file");
+    QCommandLineOption openGLOption("opengl", "Draw the video through OpenGL, scaling it on the GPU.");
+    QCommandLineOption statsOverlayOption("stats-overlay", "Show per-stage latencies over the video.");
+    QCommandLineOption profileOption("profile-ops",
+            "Profile every operator of the model and write a ranked report to a file.", "file");
+    QCommandLineOption backendsOption("armnn-backends",
+            "Comma separated ArmNN backends in order of preference (default CpuAcc).", "backends", "CpuAcc");
+    QCommandLineOption fp16Option("armnn-fp16", "Let ArmNN reduce the network to FP16 where supported.");
+    QCommandLineOption fastMathOption("armnn-fast-math", "Let ArmNN use faster, less precise kernels.");
+    QCommandLineOption cacheDirectoryOption("armnn-cache-dir",
+            "Directory the optimised ArmNN network is cached in (GpuAcc only).", "directory");
+    QCommandLineOption noCacheOption("no-armnn-cache", "Always optimise the ArmNN network from scratch.");
+    QCommandLineOption thresholdsOption("thresholds",
+            "JSON file of per-class score thresholds, see the README.", "file");
+    QCommandLineOption nmsOption("nms-iou",
+            "Overlap above which boxes of the same class are merged, 1 disables (default 0.5).", "iou", "0.5");
+    QCommandLineOption topKOption("top-k", "Keep at most this many detections, 0 for all (default 0).",
+            "count", "0");
+    QCommandLineOption modelOption(QStringList() << "m" << "model",
+            "Detection model to use (default " CPU_MODEL_NAME ").", "file", CPU_MODEL_NAME);
+    QCommandLineOption interpreterWarmupOption("interpreter-warmup",
+            "Blank inferences run on each interpreter after it is built and after a delegate switch, "
+            "0 disables (default 3).", "count", QString::number(INTERPRETER_WARMUP_RUNS));
+    QCommandLineOption mlockOption("mlock", "Lock the model and the tensor arenas into memory.");
+    QCommandLineOption inputMeanOption("input-mean",
+            "Pixel value mapped to 0 for int8 and float32 models (default 127.5).", "value", "127.5");
+    QCommandLineOption inputStdOption("input-std",
+            "Pixel range mapped to 1 for int8 and float32 models (default 127.5).", "value", "127.5");
+    inferenceSettings settings;
+    captureSettings capture;
     QString cameraLocation;
     QString modelLocation;
     QString applicationDescription =
@@ -44,28 +184,144 @@ int main(int argc, char *argv[])
     "  About->License: Read the license that this app is licensed under.\n"
     "  About->Exit: Close the application.\n"
     "  Inference->Enable/Disable: Enable or disable the ArmNN Delegate\n"
-    "                             during inference.\n\n"
+    "                             (XNNPACK Delegate on x86)\n"
+    "                             during inference.\n"
+    "  Inference->Live Detection: Continuously run inference on the live\n"
+    "                             camera feed.\n"
+    "  Inference->Export Latency Statistics: Save the per-stage latency\n"
+    "                                        histograms as CSV or JSON.\n\n"
     "Default Options:\n"
-    "  Camera: /dev/video0\n\n"
+    "  Camera: /dev/video0\n"
+    "  Model: " CPU_MODEL_NAME " in the current directory\n"
+    "  Capture backend: OpenCV (use --v4l2 for the native V4L2 backend)\n"
+    "  Capture format: UYVY, 800x600 (MIPI) or 1280x720 at 10 fps (USB)\n"
+    "  Interpreters: 1, unpinned, 2 inference threads each\n\n"
     "Application Exit Codes:\n"
     "  0: Successful exit\n"
     "  1: Camera initialisation failed\n"
     "  2: Camera stopped working";
 
     parser.addOption(cameraOption);
+    parser.addOption(modelOption);
+    parser.addOption(v4l2Option);
+    parser.addOption(formatOption);
+    parser.addOption(resolutionOption);
+    parser.addOption(fpsOption);
+    parser.addOption(jpegScaleOption);
+    parser.addOption(liveOption);
+    parser.addOption(trackOption);
+    parser.addOption(sceneThresholdOption);
+    parser.addOption(openGLOption);
+    parser.addOption(interpretersOption);
+    parser.addOption(cpuSetsOption);
+    parser.addOption(statsOption);
+    parser.addOption(statsOverlayOption);
+    parser.addOption(startupLogOption);
+    parser.addOption(profileOption);
+    parser.addOption(thresholdsOption);
+    parser.addOption(nmsOption);
+    parser.addOption(topKOption);
+    parser.addOption(interpreterWarmupOption);
+    parser.addOption(mlockOption);
+    parser.addOption(inputMeanOption);
+    parser.addOption(inputStdOption);
+    parser.addOption(backendsOption);
+    parser.addOption(fp16Option);
+    parser.addOption(fastMathOption);
+    parser.addOption(cacheDirectoryOption);
+    parser.addOption(noCacheOption);
+    parser.addOption(preprocessBenchmarkOption);
+    parser.addOption(benchmarkOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(warmupOption);
+    parser.addOption(delegateOption);
     parser.addHelpOption();
     parser.setApplicationDescription(applicationDescription);
-    parser.process(a);
+    parser.process(*a);
+
+    if (parser.isSet(statsOption))
+        latencyStats::instance().exportOnExit(parser.value(statsOption));
+
+    if (parser.isSet(startupLogOption))
+        startupTimeline::instance().setLogLocation(parser.value(startupLogOption));
+    else
+        startupTimeline::instance().setLogLocation(QDir::temp().filePath("shopping-basket-demo-startup.log"));
+
+    if (parser.isSet(preprocessBenchmarkOption))
+        return runPreprocessBenchmark(parser.value(preprocessBenchmarkOption).toUInt());
+
     cameraLocation = parser.value(cameraOption);
+    capture = parseCaptureSettings(parser.value(formatOption), parser.value(resolutionOption),
+                                   parser.value(fpsOption), parser.value(jpegScaleOption));
+
+    /* ArmNN Delegate sets the inference threads to amount of CPU cores
+     * of the same type logically group first, which for the RZ/G2L and
+     * RZ/G2M is 2. Pinned interpreters use one thread per CPU instead */
+    settings.interpreterCount = qMax(parser.value(interpretersOption).toInt(), 1);
+    settings.defaultThreads = 2;
+
+    /* Every worker created appends its report, so start from an empty file */
+    if (parser.isSet(profileOption)) {
+        settings.profileLocation = parser.value(profileOption);
+        QFile::remove(settings.profileLocation);
+    }
+
+    settings.thresholdsLocation = parser.value(thresholdsOption);
+    settings.nmsIouThreshold = parser.value(nmsOption).toFloat();
+    settings.topK = parser.value(topKOption).toInt();
+    settings.inputMean = parser.value(inputMeanOption).toFloat();
+    settings.inputDeviation = parser.value(inputStdOption).toFloat();
+    settings.warmupRuns = parser.value(interpreterWarmupOption).toInt();
+    settings.lockMemory = parser.isSet(mlockOption);
 
-    modelLocation = CPU_MODEL_NAME;
+    settings.armnnBackends = parser.value(backendsOption).split(',', QString::SkipEmptyParts);
+    settings.armnnFp16 = parser.isSet(fp16Option);
+    settings.armnnFastMath = parser.isSet(fastMathOption);
+
+    if (parser.isSet(cacheDirectoryOption))
+        settings.armnnCacheDirectory = parser.value(cacheDirectoryOption);
+    else
+        settings.armnnCacheDirectory = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+                                       "/shopping-basket-demo";
+
+    if (parser.isSet(noCacheOption))
+        settings.armnnCacheDirectory.clear();
+
+    for (const QString &cpuList : parser.value(cpuSetsOption).split(';', QString::SkipEmptyParts))
+        settings.cpuSets.append(parseCpuList(cpuList));
+
+    modelLocation = parser.value(modelOption);
 
     if (!QFile::exists(modelLocation))
-            qFatal("%s not found in the current directory",
+            qFatal("%s not found",
                     modelLocation.toStdString().c_str());
 
+    if (parser.isSet(benchmarkOption)) {
+        QStringList delegates = {parser.value(delegateOption)};
+
+        if (delegates.first() == "both")
+            delegates = QStringList({"tflite", QString(DELEGATE_NAME).toLower()});
+
+        return runInferenceBenchmark(parser.value(benchmarkOption), modelLocation, settings, delegates,
+                                     parser.value(iterationsOption).toUInt(),
+                                     parser.value(warmupOption).toUInt());
+    }
+
+    /* The delegate available depends on the build, ArmNN on Arm and XNNPACK on x86 */
+    QString delegate = parser.value(delegateOption);
+
+    if (delegate != "tflite" && delegate != "both" && delegate != QString(DELEGATE_NAME).toLower()) {
+        if (delegate == "armnn" || delegate == "xnnpack")
+            qFatal("The %s delegate is not available in this build", delegate.toStdString().c_str());
+        else
+            qFatal("Unknown delegate %s", delegate.toStdString().c_str());
+    }
+
     QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
-    MainWindow w(nullptr, cameraLocation, modelLocation);
+    MainWindow w(nullptr, cameraLocation, modelLocation, parser.isSet(v4l2Option), capture,
+                 parser.isSet(liveOption), settings, parser.isSet(statsOverlayOption),
+                 delegate != "tflite", parser.value(trackOption).toInt(),
+                 parser.value(sceneThresholdOption).toFloat(), parser.isSet(openGLOption));
     w.show();
-    return a.exec();
+    return a->exec();
 }
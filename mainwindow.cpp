@@ -17,19 +17,28 @@
  *****************************************************************************************/
 
 #include <QGraphicsScene>
-#include <QGraphicsTextItem>
+#include <QGraphicsItem>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QOpenGLWidget>
 #include <QSplashScreen>
+#include <QtConcurrent>
 #include <QSysInfo>
+#include <QThread>
+#include <QTimer>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "detectionpipeline.h"
+#include "latencystats.h"
 #include "tfliteworker.h"
 #include "opencvworker.h"
+#include "overlayitem.h"
+#include "startuptimeline.h"
+#include "videoitem.h"
 #include "videoworker.h"
 
 const QStringList MainWindow::labelList = {"Baked Beans", "Coke", "Diet Coke",
@@ -43,15 +52,19 @@ const std::vector<float> MainWindow::costs = {float(0.85), float(0.82),
                                               float(0.89), float(0.85),
                                               float(1.20), float(0.69)};
 
-MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLocation)
+MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLocation, bool nativeCapture,
+                       const captureSettings &capture, bool liveDetection, const inferenceSettings &settings, bool statsOverlay,
+                       bool useDelegate, int trackingInterval, float sceneThreshold, bool openGL)
     : QMainWindow(parent),
       ui(new Ui::MainWindow)
 {
     Board board = Unknown;
 
+    startupTimeline::instance().mark("gui", "Creating the main window");
+
     QPixmap splashScreenImage("/opt/shopping-basket-demo/logos/rz-splashscreen.png");
 
-    QSplashScreen *splashScreen = new QSplashScreen(splashScreenImage);
+    splashScreen = new QSplashScreen(splashScreenImage);
     splashScreen->setAttribute(Qt::WA_DeleteOnClose, true);
     splashScreen->show();
     splashScreen->showMessage("Loading the \nRZG Shopping Basket Demo", Qt::AlignCenter, Qt::blue);
@@ -60,42 +73,48 @@ MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLoc
     splashScreen->setFont(font);
 
     modelPath = modelLocation;
-    useArmNNDelegate = true;
+    poolSettings = settings;
+    useArmNNDelegate = useDelegate;
+    maximumTrackingInterval = trackingInterval;
+    sceneChangeThreshold = sceneThreshold;
+    lastFrameSequence = 0;
+    pipeline = nullptr;
+    vidWorker = nullptr;
+    videoThread = nullptr;
+    videoRunning = false;
+    tfWorker = nullptr;
+    pendingRequestId = 0;
+    statsTimer = nullptr;
+    cvWorker = nullptr;
+    cameraWatcher = nullptr;
+    modelWatcher = nullptr;
+    startLive = liveDetection;
+    showStatsOverlay = statsOverlay;
+    firstFrameShown = false;
+    inferenceAvailable = false;
+    emptyDetections = std::make_shared<const detectionList>();
+    outputDetections = emptyDetections;
 
     ui->setupUi(this);
-    this->resize(APP_WIDTH, APP_HEIGHT);
-    ui->tableWidget->verticalHeader()->setDefaultSectionSize(25);
-    scene = new QGraphicsScene(this);
-    ui->graphicsView->setScene(scene);
-
-    ui->graphicsView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    ui->graphicsView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-
-    font.setPointSize(14);
-    ui->tableWidget->setHorizontalHeaderLabels({"Item", "Price"});
-    ui->tableWidget->horizontalHeader()->setFont(font);
-    ui->tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    ui->tableWidget->resizeColumnsToContents();
-    double column1Width = ui->tableWidget->geometry().width() * 0.8;
-    ui->tableWidget->setColumnWidth(0, column1Width);
-    ui->tableWidget->horizontalHeader()->setStretchLastSection(true);
-
-    ui->labelInference->setText(TEXT_INFERENCE);
-    ui->labelTotalItems->setText(TEXT_TOTAL_ITEMS);
-
-    QPixmap rzLogo;
-    rzLogo.load("/opt/shopping-basket-demo/logos/renesas-rz-logo.png");
-    ui->labelRzLogo->setPixmap(rzLogo);
 
-    setProcessButton(true);
+    /* Enabled once inference is ready, live detection once the model is loaded
+     * and the camera settings once the camera is up. Set before the model and
+     * camera tasks start so their completion can't be overridden */
+    setProcessButton(false);
     setNextButton(false);
+    ui->actionLive_Detection->setEnabled(false);
+    ui->menuCam_Settings->setEnabled(false);
+
+    qRegisterMetaType<detectionResult>("detectionResult");
 
-    qRegisterMetaType<QVector<float> >("QVector<float>");
+    /* The model loads and the camera is brought up while the UI is built */
+    createTfWorker();
 
     QSysInfo systemInfo;
+    QString title;
 
     if (systemInfo.machineHostName() == "hihope-rzg2m") {
-        setWindowTitle("Shopping Basket Demo - RZ/G2M");
+        title = "Shopping Basket Demo - RZ/G2M";
         boardInfo = G2M_HW_INFO;
         board = G2M;
 
@@ -107,7 +126,7 @@ MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLoc
         }
 
     } else if (systemInfo.machineHostName() == "smarc-rzg2l") {
-        setWindowTitle("Shopping Basket Demo - RZ/G2L");
+        title = "Shopping Basket Demo - RZ/G2L";
         boardInfo = G2L_HW_INFO;
         board = G2L;
 
@@ -115,7 +134,7 @@ MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLoc
             cameraLocation = QString("/dev/video0");
 
     } else if (systemInfo.machineHostName() == "smarc-rzg2lc") {
-        setWindowTitle("Shopping Basket Demo - RZ/G2LC");
+        title = "Shopping Basket Demo - RZ/G2LC";
         boardInfo = G2LC_HW_INFO;
         board = G2L;
 
@@ -123,7 +142,7 @@ MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLoc
             cameraLocation = QString("/dev/video0");
 
     } else if (systemInfo.machineHostName() == "ek874") {
-        setWindowTitle("Shopping Basket Demo - RZ/G2E");
+        title = "Shopping Basket Demo - RZ/G2E";
         boardInfo = G2E_HW_INFO;
         board = G2E;
 
@@ -134,12 +153,79 @@ MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLoc
                 cameraLocation = QString("/dev/video0");
         }
     } else {
-        setWindowTitle("Shopping Basket Demo");
+        title = "Shopping Basket Demo";
         boardInfo = HW_INFO_WARNING;
     }
 
     qRegisterMetaType<cv::Mat>();
-    cvWorker = new opencvWorker(cameraLocation, board);
+    createCvWorker(cameraLocation, board, nativeCapture, capture);
+
+    setWindowTitle(title);
+    updateDelegateText();
+    this->resize(APP_WIDTH, APP_HEIGHT);
+    ui->tableWidget->verticalHeader()->setDefaultSectionSize(25);
+    scene = new QGraphicsScene(this);
+    ui->graphicsView->setScene(scene);
+
+    ui->graphicsView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    ui->graphicsView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+
+    /* The frame and the overlay stay in the scene, only their contents change */
+    videoFrame = new videoItem;
+    scene->addItem(videoFrame);
+
+    overlay = new overlayItem;
+    overlay->setLabels(labelList);
+    scene->addItem(overlay);
+
+    statsBackground = scene->addRect(QRectF(), QPen(Qt::NoPen), QBrush(QColor(0, 0, 0, 160)));
+    statsBackground->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+    statsBackground->setZValue(2);
+    statsBackground->hide();
+
+    statsItem = scene->addSimpleText(QString(), QFont("monospace", STATS_OVERLAY_FONT_SIZE));
+    statsItem->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+    statsItem->setBrush(TEXT_COLOUR);
+    statsItem->setZValue(3);
+    statsItem->hide();
+
+    /* Each frame covers the whole view, so skip working out what changed */
+    ui->graphicsView->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+    ui->graphicsView->setOptimizationFlags(QGraphicsView::DontAdjustForAntialiasing |
+                                           QGraphicsView::DontSavePainterState);
+
+    /* Frames are uploaded as textures and scaled on the GPU */
+    if (openGL) {
+        ui->graphicsView->setViewport(new QOpenGLWidget);
+        ui->graphicsView->setRenderHint(QPainter::SmoothPixmapTransform);
+    }
+
+    font.setPointSize(14);
+    ui->tableWidget->setHorizontalHeaderLabels({"Item", "Price"});
+    ui->tableWidget->horizontalHeader()->setFont(font);
+    ui->tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ui->tableWidget->resizeColumnsToContents();
+    double column1Width = ui->tableWidget->geometry().width() * 0.8;
+    ui->tableWidget->setColumnWidth(0, column1Width);
+    ui->tableWidget->horizontalHeader()->setStretchLastSection(true);
+
+    ui->labelInference->setText(TEXT_INFERENCE);
+    ui->labelTotalItems->setText(TEXT_TOTAL_ITEMS);
+
+    QPixmap rzLogo;
+    rzLogo.load("/opt/shopping-basket-demo/logos/renesas-rz-logo.png");
+    ui->labelRzLogo->setPixmap(rzLogo);
+
+    startupTimeline::instance().mark("gui", "User interface built");
+}
+
+/*
+ * The camera is up: report it if it failed, otherwise start showing frames,
+ * which does not wait for the model
+ */
+void MainWindow::cameraReady()
+{
+    cvWorker = cameraWatcher->result();
 
     splashScreen->close();
 
@@ -151,66 +237,273 @@ MainWindow::MainWindow(QWidget *parent, QString cameraLocation, QString modelLoc
         errorPopup(TEXT_CAMERA_OPENING_ERROR, EXIT_CAMERA_STOPPED_ERROR);
     } else {
         createVideoWorker();
-        createTfWorker();
 
-        /* Limit camera loop speed if using mipi camera to save on CPU
+        /* Limit the preview rate if using mipi camera to save on CPU
          * USB camera is alreay limited to 10 FPS */
         if (cvWorker->getUsingMipi())
-            vidWorker->setDelayMS(MIPI_VIDEO_DELAY);
+            vidWorker->setTargetFps(VIDEO_MIPI_TARGET_FPS);
 
         /* If a Mipi camera is not in use then hide the menu that
          * is only supported for the OV5645 */
         if (!cvWorker->getUsingMipi())
             ui->menuCam_Settings->menuAction()->setVisible(false);
+        else
+            ui->menuCam_Settings->setEnabled(true);
+
+        if (showStatsOverlay) {
+            statsTimer = new QTimer(this);
+            connect(statsTimer, SIGNAL(timeout()), this, SLOT(updateStatsOverlay()));
+            statsTimer->start(STATS_OVERLAY_INTERVAL_MS);
+        }
+
+        startupTimeline::instance().mark("gui", "Camera ready");
+
+        /* Live detection starts once the model has loaded */
+        if (!startLive)
+            start_video();
+
+        completeStartup();
+    }
+}
+
+void MainWindow::modelReady()
+{
+    tfWorker = modelWatcher->result();
+    tfWorker->setDelegate(useArmNNDelegate);
+
+    connect(tfWorker, SIGNAL(sendOutputTensor(const detectionResult&, int, const cv::Mat&, quint64)),
+            this, SLOT(receiveOutputTensor(const detectionResult&, int, const cv::Mat&, quint64)),
+            Qt::QueuedConnection);
+    connect(tfWorker, SIGNAL(interpretersReady()), this, SLOT(inferenceReady()), Qt::QueuedConnection);
+
+    startupTimeline::instance().mark("gui", "Model loaded");
+    completeStartup();
+
+    /* The interpreters may have been built before the signal was connected */
+    if (tfWorker->isReady())
+        inferenceReady();
+}
+
+/* Create the live detection pipeline once both the camera and the model are ready */
+void MainWindow::completeStartup()
+{
+    if (cvWorker == nullptr || vidWorker == nullptr || tfWorker == nullptr || pipeline != nullptr)
+        return;
 
-        start_video();
+    createPipeline();
+    ui->actionLive_Detection->setEnabled(true);
+
+    if (startLive)
+        startLiveDetection();
+    else if (inferenceAvailable && videoRunning)
+        setProcessButton(true);
+}
+
+void MainWindow::inferenceReady()
+{
+    if (inferenceAvailable || !tfWorker->isReady())
+        return;
+
+    inferenceAvailable = true;
+    startupTimeline::instance().mark("gui", "Inference ready");
+
+    if (pipeline != nullptr && !pipeline->isRunning() && videoRunning)
+        setProcessButton(true);
+
+    if (firstFrameShown)
+        startupTimeline::instance().complete();
+}
+
+/* Startup is complete once a frame has been shown and inference is ready */
+void MainWindow::markFirstFrame()
+{
+    if (firstFrameShown)
+        return;
+
+    firstFrameShown = true;
+    startupTimeline::instance().mark("gui", "First frame shown");
+
+    if (inferenceAvailable)
+        startupTimeline::instance().complete();
+}
+
+MainWindow::~MainWindow()
+{
+    /* Startup may still be running if the application is closed straight away */
+    if (cameraWatcher != nullptr)
+        cameraWatcher->waitForFinished();
+
+    modelWatcher->waitForFinished();
+
+    if (tfWorker == nullptr)
+        tfWorker = modelWatcher->result();
+
+    /* Stop the pipeline threads before the workers they use go away */
+    delete pipeline;
+
+    if (tfWorker != nullptr)
+        destroyTfWorker();
+
+    /* The worker's frame timer is stopped along with its thread */
+    if (videoThread != nullptr) {
+        videoThread->quit();
+        videoThread->wait();
+        delete vidWorker;
     }
 }
 
+/*
+ * The worker paces the preview from its own thread, so its timer keeps time
+ * however busy the GUI thread is
+ */
 void MainWindow::createVideoWorker()
 {
-    vidWorker = new videoWorker();
+    videoThread = new QThread(this);
+    vidWorker = new videoWorker(cvWorker);
+    vidWorker->moveToThread(videoThread);
+    videoThread->start();
 
     connect(vidWorker, SIGNAL(showVideo()), this, SLOT(ShowVideo()));
+    connect(vidWorker, SIGNAL(showDetections(const QImage&, const detectionResult&, int)),
+            this, SLOT(receiveLiveDetections(const QImage&, const detectionResult&, int)));
+    connect(vidWorker, SIGNAL(cameraFailure()), this, SLOT(cameraFailure()));
     connect(this, SIGNAL(startVideo()), vidWorker, SLOT(StartVideo()));
     connect(this, SIGNAL(stopVideo()), vidWorker, SLOT(StopVideo()));
 }
 
 void MainWindow::start_video()
 {
+    videoRunning = true;
     emit startVideo();
 }
 
 void MainWindow::stop_video()
 {
+    if (videoRunning)
+        qInfo("Video: target %.0f fps, achieved %.1f fps, %llu frames dropped",
+              vidWorker->getTargetFps(), vidWorker->getAchievedFps(),
+              (unsigned long long)vidWorker->getDroppedFrames());
+
+    videoRunning = false;
     emit stopVideo();
 }
 
+/*
+ * Bring the camera up on another thread, including any reconnection attempts,
+ * and hand the worker back to the GUI thread in cameraReady()
+ */
+void MainWindow::createCvWorker(QString cameraLocation, Board board, bool nativeCapture,
+                                const captureSettings &capture)
+{
+    QThread *guiThread = thread();
+
+    cameraWatcher = new QFutureWatcher<opencvWorker*>(this);
+    connect(cameraWatcher, SIGNAL(finished()), this, SLOT(cameraReady()));
+
+    cameraWatcher->setFuture(QtConcurrent::run([=]() {
+        startupTimeline::instance().mark("camera", "Opening " + cameraLocation);
+
+        opencvWorker *worker = new opencvWorker(cameraLocation, board, nativeCapture, capture);
+
+        worker->moveToThread(guiThread);
+        startupTimeline::instance().mark("camera", "First frame captured");
+
+        return worker;
+    }));
+}
+
+/*
+ * Map the model and parse it on another thread, the worker then builds its
+ * interpreters in the background and is handed back in modelReady(). Each
+ * interpreter runs on its own thread from the pool, so requests never block
+ * the GUI
+ */
 void MainWindow::createTfWorker()
 {
-    /* ArmNN Delegate sets the inference threads to amount of CPU cores
-     * of the same type logically group first, which for the RZ/G2L and
-     * RZ/G2M is 2 */
-    int inferenceThreads = 2;
-    tfWorker = new tfliteWorker(modelPath, useArmNNDelegate, inferenceThreads);
+    QString model = modelPath;
+    inferenceSettings settings = poolSettings;
+    bool useDelegate = useArmNNDelegate;
+    QThread *guiThread = thread();
+
+    modelWatcher = new QFutureWatcher<tfliteWorker*>(this);
+    connect(modelWatcher, SIGNAL(finished()), this, SLOT(modelReady()));
+
+    modelWatcher->setFuture(QtConcurrent::run([=]() {
+        startupTimeline::instance().mark("model", "Loading " + model);
+
+        tfliteWorker *worker = new tfliteWorker(model, useDelegate, settings);
+
+        worker->moveToThread(guiThread);
+
+        return worker;
+    }));
+}
+
+void MainWindow::destroyTfWorker()
+{
+    /* Deleting the worker waits for the interpreter threads to finish */
+    tfWorker->cancelRequests();
+
+    delete tfWorker;
+    tfWorker = nullptr;
+    pendingRequestId = 0;
+}
+
+void MainWindow::createPipeline()
+{
+    vidWorker->setLabels(labelList);
+    pipeline = new detectionPipeline(cvWorker, tfWorker, vidWorker, maximumTrackingInterval,
+                                     sceneChangeThreshold);
+}
+
+void MainWindow::receiveOutputTensor(const detectionResult& receivedDetections, int receivedTimeElapsed, const cv::Mat& receivedMat, quint64 requestId)
+{
+    /* Ignore results for requests that have been superseded or cancelled */
+    if (requestId != pendingRequestId)
+        return;
+
+    pendingRequestId = 0;
+    outputDetections = receivedDetections;
+    updateCheckoutList(receivedTimeElapsed);
+
+    if (!ui->pushButtonProcessBasket->isEnabled())
+        drawMatToView(receivedMat);
+
+    drawBoxes();
+}
 
-    connect(tfWorker, SIGNAL(sendOutputTensor(const QVector<float>&, int, const cv::Mat&)),
-            this, SLOT(receiveOutputTensor(const QVector<float>&, int, const cv::Mat&)));
+/*
+ * Display a frame from the live detection pipeline, the boxes have already
+ * been drawn onto it by the render stage
+ */
+void MainWindow::receiveLiveDetections(const QImage& renderedImage, const detectionResult& receivedDetections, int receivedTimeElapsed)
+{
+    if (!pipeline->isRunning())
+        return;
+
+    outputDetections = receivedDetections;
+    updateCheckoutList(receivedTimeElapsed);
+    drawImageToView(renderedImage);
+    ui->labelTotalItems->setText(TEXT_TOTAL_ITEMS + QString("%1").arg(outputDetections->size()));
+    markFirstFrame();
 }
 
-void MainWindow::receiveOutputTensor(const QVector<float>& receivedTensor, int receivedTimeElapsed, const cv::Mat& receivedMat)
+void MainWindow::updateCheckoutList(int receivedTimeElapsed)
 {
     QTableWidgetItem* item;
     QTableWidgetItem* price;
     float totalCost = 0;
 
-    outputTensor = receivedTensor;
     ui->tableWidget->setRowCount(0);
     labelListSorted.clear();
 
-    for (int i = 0; (i + 5) < receivedTensor.size(); i += 6) {
-        totalCost += costs[int(outputTensor[i])];
-        labelListSorted.push_back(labelList[int(outputTensor[i])]);
+    for (const detection &item : *outputDetections) {
+        /* Models other than the demo's can detect classes that aren't for sale */
+        if (item.item < 0 || item.item >= labelList.size())
+            continue;
+
+        totalCost += costs[item.item];
+        labelListSorted.push_back(labelList[item.item]);
     }
 
     labelListSorted.sort();
@@ -237,47 +530,25 @@ void MainWindow::receiveOutputTensor(const QVector<float>& receivedTensor, int r
     item = new QTableWidgetItem("£" + QString::number(double(totalCost), 'f', 2));
     item->setTextAlignment(Qt::AlignBottom | Qt::AlignRight);
     ui->tableWidget->setItem(ui->tableWidget->rowCount()-1, 1, item);
-
-    if (!ui->pushButtonProcessBasket->isEnabled())
-        drawMatToView(receivedMat);
-
-    drawBoxes();
 }
 
 void MainWindow::drawBoxes()
 {
-    for (int i = 0; (i + 5) < outputTensor.size(); i += 6) {
-        QPen pen;
-        QBrush brush;
-        QGraphicsTextItem* itemName = scene->addText(nullptr);
-        float ymin = outputTensor[i + 2] * float(scene->height());
-        float xmin = outputTensor[i + 3] * float(scene->width());
-        float ymax = outputTensor[i + 4] * float(scene->height());
-        float xmax = outputTensor[i + 5] * float(scene->width());
-        float scorePercentage = outputTensor[i + 1] * 100;
-
-        pen.setColor(BOX_COLOUR);
-        pen.setWidth(BOX_WIDTH);
-
-        itemName->setHtml(QString("<div style='background:rgba(0, 0, 0, 100%);font-size:xx-large;'>" +
-                                  QString(labelList[int(outputTensor[i])] + " " +
-                                  QString::number(double(scorePercentage), 'f', 1) + "%") +
-                                  QString("</div>")));
-        itemName->setPos(xmin, ymin);
-        itemName->setDefaultTextColor(TEXT_COLOUR);
-        itemName->setZValue(1);
-
-        scene->addRect(double(xmin), double(ymin), double(xmax - xmin), double(ymax - ymin), pen, brush);
-    }
-    ui->labelTotalItems->setText(TEXT_TOTAL_ITEMS + QString("%1").arg(outputTensor.size() / 6));
+    overlay->setDetections(outputDetections);
+    ui->labelTotalItems->setText(TEXT_TOTAL_ITEMS + QString("%1").arg(outputDetections->size()));
 }
 
 void MainWindow::on_pushButtonNextBasket_clicked()
 {
-    setProcessButton(true);
+    /* Drop the basket that is still being processed, if there is one */
+    tfWorker->cancelRequests();
+    pendingRequestId = 0;
+
+    /* Live detection can be stopped before inference is ready */
+    setProcessButton(inferenceAvailable);
     setNextButton(false);
 
-    outputTensor.clear();
+    outputDetections = emptyDetections;
     ui->tableWidget->setRowCount(0);
     ui->labelInference->setText(TEXT_INFERENCE);
     ui->labelTotalItems->setText(TEXT_TOTAL_ITEMS);
@@ -287,37 +558,46 @@ void MainWindow::on_pushButtonNextBasket_clicked()
 
 void MainWindow::ShowVideo()
 {
-    const cv::Mat* image;
+    const capturedFrame* frame;
+
+    /* A request can still be queued when the video has just been stopped */
+    if (!videoRunning) {
+        vidWorker->frameDisplayed(0);
+        return;
+    }
 
-    image = cvWorker->getImage(1);
+    frame = cvWorker->getFrame();
 
-    if (image == nullptr) {
+    if (frame == nullptr) {
         stop_video();
         setProcessButton(false);
 
         qWarning("Camera no longer working. Quitting.");
         errorPopup(TEXT_CAMERA_FAILURE_ERROR, EXIT_CAMERA_STOPPED_ERROR);
-    } else {
-        drawMatToView(*image);
+    } else if (frame->sequence != lastFrameSequence) {
+        /* Only redraw when the capture thread has published a new frame */
+        lastFrameSequence = frame->sequence;
+        drawMatToView(frame->image);
+        markFirstFrame();
     }
+
+    /* Lets the worker request the next frame, and times this one */
+    if (frame != nullptr)
+        vidWorker->frameDisplayed(frame->sequence);
 }
 
 void MainWindow::on_pushButtonProcessBasket_clicked()
 {
     const cv::Mat* image;
-    unsigned int iterations;
 
     stop_video();
 
     setProcessButton(false);
     setNextButton(true);
 
-    if (cvWorker->getUsingMipi())
-        iterations = 6;
-    else
-        iterations = 2;
-
-    image = cvWorker->getImage(iterations);
+    /* The capture thread keeps the camera buffers drained, so the newest
+     * published frame is already fresh */
+    image = cvWorker->getImage();
 
     if (image == nullptr) {
         setNextButton(false);
@@ -325,11 +605,11 @@ void MainWindow::on_pushButtonProcessBasket_clicked()
         qWarning("Camera not working. Quitting.");
         errorPopup(TEXT_CAMERA_FAILURE_ERROR, EXIT_CAMERA_STOPPED_ERROR);
     } else {
-        outputTensor.clear();
+        outputDetections = emptyDetections;
         ui->tableWidget->setRowCount(0);
         ui->labelInference->setText(TEXT_INFERENCE);
 
-        tfWorker->receiveImage(*image);
+        pendingRequestId = tfWorker->submitImage(*image);
     }
 }
 
@@ -370,8 +650,6 @@ void MainWindow::setProcessButton(bool enable)
         ui->pushButtonProcessBasket->setStyleSheet(BUTTON_GREYED_OUT);
         ui->pushButtonProcessBasket->setEnabled(false);
     }
-
-    qApp->processEvents(QEventLoop::WaitForMoreEvents);
 }
 
 void MainWindow::setNextButton(bool enable)
@@ -383,56 +661,141 @@ void MainWindow::setNextButton(bool enable)
         ui->pushButtonNextBasket->setStyleSheet(BUTTON_GREYED_OUT);
         ui->pushButtonNextBasket->setEnabled(false);
     }
-
-    qApp->processEvents(QEventLoop::WaitForMoreEvents);
 }
 
 void MainWindow::drawMatToView(const cv::Mat& matInput)
 {
-    QImage imageToDraw;
+    videoFrame->setFrame(matInput);
+    updateView();
+}
+
+void MainWindow::drawImageToView(const QImage& imageInput)
+{
+    videoFrame->setImage(imageInput);
+    updateView();
+}
+
+/*
+ * Remove the previous frame's boxes and fit the view to the frame. USB
+ * cameras are shown at VIDEO_DISPLAY_WIDTH by VIDEO_DISPLAY_HEIGHT whatever
+ * their resolution, by scaling the view rather than the image
+ */
+void MainWindow::updateView()
+{
+    stageTimer timer(STAGE_SCENE_REDRAW);
+    QRectF frameRect = videoFrame->boundingRect();
+
+    overlay->setDetections(emptyDetections);
 
-    imageToDraw = matToQImage(matInput);
+    if (scene->sceneRect() == frameRect || frameRect.isEmpty())
+        return;
 
-    image = QPixmap::fromImage(imageToDraw);
-    scene->clear();
+    scene->setSceneRect(frameRect);
+    overlay->setFrameSize(frameRect.size());
 
-    if (!cvWorker->getUsingMipi())
-        image = image.scaled(800, 600);
+    /* MIPI frames are the display size unless another resolution was asked for */
+    if (frameRect.size() == QSizeF(VIDEO_DISPLAY_WIDTH, VIDEO_DISPLAY_HEIGHT))
+        ui->graphicsView->resetTransform();
+    else
+        ui->graphicsView->setTransform(QTransform::fromScale(VIDEO_DISPLAY_WIDTH / frameRect.width(),
+                                                             VIDEO_DISPLAY_HEIGHT / frameRect.height()));
+}
 
-    scene->addPixmap(image);
-    scene->setSceneRect(image.rect());
+/* The delegate is ArmNN on Arm and XNNPACK on x86 */
+void MainWindow::updateDelegateText()
+{
+    if (useArmNNDelegate) {
+        ui->actionEnable_ArmNN_Delegate->setText("Disable " DELEGATE_NAME " Delegate");
+        ui->labelDelegate->setText("TensorFlow Lite + " DELEGATE_NAME " delegate");
+    } else {
+        ui->actionEnable_ArmNN_Delegate->setText("Enable " DELEGATE_NAME " Delegate");
+        ui->labelDelegate->setText("TensorFlow Lite");
+    }
 }
 
-QImage MainWindow::matToQImage(const cv::Mat& matToConvert)
+void MainWindow::on_actionEnable_ArmNN_Delegate_triggered()
 {
-    QImage convertedImage;
+    /* Toggle delegate state, both interpreters are already built so the
+     * next request simply runs on the other one */
+    useArmNNDelegate = !useArmNNDelegate;
+    updateDelegateText();
+
+    /* Otherwise applied once the model has loaded */
+    if (tfWorker != nullptr)
+        tfWorker->setDelegate(useArmNNDelegate);
+}
 
-    if (matToConvert.empty())
-        return QImage(nullptr);
+void MainWindow::on_actionLive_Detection_triggered()
+{
+    if (pipeline->isRunning())
+        stopLiveDetection();
+    else
+        startLiveDetection();
+}
 
-    convertedImage = QImage(matToConvert.data, matToConvert.cols,
-                     matToConvert.rows, int(matToConvert.step),
-                        QImage::Format_RGB888).copy();
+void MainWindow::on_actionExport_Latency_Statistics_triggered()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Latency Statistics", "latency.json",
+                                                    "JSON (*.json);;CSV (*.csv)");
 
-    return convertedImage;
+    if (!fileName.isEmpty())
+        latencyStats::instance().exportStatistics(fileName);
 }
 
-void MainWindow::on_actionEnable_ArmNN_Delegate_triggered()
+/* Refresh the statistics drawn over the video */
+void MainWindow::updateStatsOverlay()
 {
-    /* Update the GUI text */
-    if(useArmNNDelegate) {
-        ui->actionEnable_ArmNN_Delegate->setText("Enable ArmNN Delegate");
-        ui->labelDelegate->setText("TensorFlow Lite");
-    } else {
-        ui->actionEnable_ArmNN_Delegate->setText("Disable ArmNN Delegate");
-        ui->labelDelegate->setText("TensorFlow Lite + ArmNN delegate");
+    QString statsText = latencyStats::instance().getSummary();
+
+    if (videoRunning) {
+        QString videoText = QString("%1 target %2 achieved %3 fps").arg("video", -18)
+                            .arg(vidWorker->getTargetFps(), 0, 'f', 0)
+                            .arg(vidWorker->getAchievedFps(), 0, 'f', 1);
+
+        statsText = statsText.isEmpty() ? videoText : statsText + "\n" + videoText;
     }
 
-    /* Toggle delegate state */
-    useArmNNDelegate = !useArmNNDelegate;
+    statsItem->setText(statsText);
+    statsBackground->setRect(statsItem->boundingRect());
+    statsItem->setVisible(!statsText.isEmpty());
+    statsBackground->setVisible(!statsText.isEmpty());
+}
 
-    delete tfWorker;
-    createTfWorker();
+/*
+ * Switch from the manual Process Basket flow to running detection on every
+ * frame the pipeline can keep up with
+ */
+void MainWindow::startLiveDetection()
+{
+    stop_video();
+
+    ui->actionLive_Detection->setText("Disable Live Detection");
+    setProcessButton(false);
+    setNextButton(false);
+
+    outputDetections = emptyDetections;
+    ui->tableWidget->setRowCount(0);
+    ui->labelInference->setText(TEXT_INFERENCE);
+    ui->labelTotalItems->setText(TEXT_TOTAL_ITEMS);
+
+    pipeline->start();
+}
+
+void MainWindow::stopLiveDetection()
+{
+    pipeline->stop();
+
+    ui->actionLive_Detection->setText("Enable Live Detection");
+    on_pushButtonNextBasket_clicked();
+}
+
+void MainWindow::cameraFailure()
+{
+    pipeline->stop();
+    setProcessButton(false);
+
+    qWarning("Camera no longer working. Quitting.");
+    errorPopup(TEXT_CAMERA_FAILURE_ERROR, EXIT_CAMERA_STOPPED_ERROR);
 }
 
 void MainWindow::errorPopup(QString errorMessage, int errorCode)
@@ -18,9 +18,13 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QFutureWatcher>
 #include <QMainWindow>
 #include <opencv2/videoio.hpp>
 
+#include "opencvworker.h"
+#include "tfliteworker.h"
+
 #define BUTTON_BLUE "background-color: rgba(42, 40, 157);color: rgb(255, 255, 255);border: 2px;border-radius: 55px;border-style: outset;"
 #define BUTTON_GREYED_OUT "background-color: rgba(42, 40, 157, 90);color: rgb(255, 255, 255);border: 2px;border-radius: 55px;border-style: outset;"
 
@@ -45,18 +49,28 @@
 #define BOX_WIDTH 2
 #define BOX_COLOUR Qt::green
 #define TEXT_COLOUR Qt::green
-#define MIPI_VIDEO_DELAY 50
+#define VIDEO_DISPLAY_WIDTH 800
+#define VIDEO_DISPLAY_HEIGHT 600
+#define STATS_OVERLAY_INTERVAL_MS 1000
+#define STATS_OVERLAY_FONT_SIZE 10
 
 /* Application exit codes */
 #define EXIT_OKAY 0
 #define EXIT_CAMERA_INIT_ERROR 1
 #define EXIT_CAMERA_STOPPED_ERROR 2
 
+class QGraphicsRectItem;
 class QGraphicsScene;
+class QGraphicsSimpleTextItem;
 class QGraphicsView;
+class QSplashScreen;
+class detectionPipeline;
 class opencvWorker;
-class tfliteWorker;
+class overlayItem;
 class QElapsedTimer;
+class QThread;
+class QTimer;
+class videoItem;
 class videoWorker;
 
 namespace Ui { class MainWindow; } //Needed for mainwindow.ui
@@ -66,7 +80,10 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent, QString cameraLocation, QString modelLocation);
+    MainWindow(QWidget *parent, QString cameraLocation, QString modelLocation, bool nativeCapture,
+               const captureSettings &capture, bool liveDetection, const inferenceSettings &settings, bool statsOverlay,
+               bool useDelegate, int trackingInterval, float sceneThreshold, bool openGL);
+    ~MainWindow();
 
 signals:
     void startVideo();
@@ -76,11 +93,19 @@ public slots:
     void ShowVideo();
 
 private slots:
-    void receiveOutputTensor (const QVector<float>& receivedTensor, int recievedTimeElapsed, const cv::Mat&);
+    void receiveOutputTensor (const detectionResult& receivedDetections, int recievedTimeElapsed, const cv::Mat&, quint64 requestId);
+    void receiveLiveDetections(const QImage& renderedImage, const detectionResult& receivedDetections, int receivedTimeElapsed);
+    void cameraFailure();
+    void cameraReady();
+    void modelReady();
+    void inferenceReady();
     void on_pushButtonProcessBasket_clicked();
     void on_pushButtonNextBasket_clicked();
     void on_actionLicense_triggered();
     void on_actionEnable_ArmNN_Delegate_triggered();
+    void on_actionLive_Detection_triggered();
+    void on_actionExport_Latency_Statistics_triggered();
+    void updateStatsOverlay();
     void on_actionHardware_triggered();
     void on_actionExit_triggered();
     void start_video();
@@ -92,9 +117,19 @@ private slots:
 private:
     void drawBoxes();
     void drawMatToView(const cv::Mat& matInput);
+    void drawImageToView(const QImage& imageInput);
+    void updateView();
+    void updateCheckoutList(int receivedTimeElapsed);
+    void createCvWorker(QString cameraLocation, Board board, bool nativeCapture, const captureSettings &capture);
     void createTfWorker();
-    QImage matToQImage(const cv::Mat& matToConvert);
+    void updateDelegateText();
+    void destroyTfWorker();
+    void createPipeline();
+    void startLiveDetection();
+    void stopLiveDetection();
     void createVideoWorker();
+    void completeStartup();
+    void markFirstFrame();
     void setProcessButton(bool enable);
     void setNextButton(bool enable);
     void errorPopup(QString errorMessage, int errorCode);
@@ -102,18 +137,38 @@ private:
     Ui::MainWindow *ui;
     bool useArmNNDelegate;
     QFont font;
-    QPixmap image;
     QGraphicsScene *scene;
-    QVector<float> outputTensor;
+    videoItem *videoFrame;
+    overlayItem *overlay;
+    QGraphicsSimpleTextItem *statsItem;
+    QGraphicsRectItem *statsBackground;
+    detectionResult outputDetections;
+    detectionResult emptyDetections;
     QGraphicsView *graphicsView;
     opencvWorker *cvWorker;
     tfliteWorker *tfWorker;
+    inferenceSettings poolSettings;
+    quint64 pendingRequestId;
+    int maximumTrackingInterval;
+    float sceneChangeThreshold;
     QStringList labelListSorted;
     QString boardInfo;
     QString modelPath;
     static const QStringList labelList;
     static const std::vector<float> costs;
     videoWorker *vidWorker;
+    QThread *videoThread;
+    bool videoRunning;
+    detectionPipeline *pipeline;
+    quint64 lastFrameSequence;
+    QTimer *statsTimer;
+    QSplashScreen *splashScreen;
+    QFutureWatcher<opencvWorker*> *cameraWatcher;
+    QFutureWatcher<tfliteWorker*> *modelWatcher;
+    bool startLive;
+    bool showStatsOverlay;
+    bool firstFrameShown;
+    bool inferenceAvailable;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,333 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+#include <QFile>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/media-bus-format.h>
+#include <linux/media.h>
+#include <linux/v4l2-subdev.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "mediacontroller.h"
+
+static const mediaTopology topologies[] = {
+    {G2L, "rzg2l_csi2 10830400.csi2", "CRU output", "ov5645 0-003c"},
+    {G2M, "rcar_csi2 fea80000.csi2", "VIN0 output", "ov5645 2-003c"},
+    {G2E, "rcar_csi2 feaa0000.csi2", "VIN4 output", "ov5645 3-003c"},
+};
+
+static int xioctl(int fd, unsigned long request, void *argument)
+{
+    int status;
+
+    do {
+        status = ioctl(fd, request, argument);
+    } while (status == -1 && errno == EINTR);
+
+    return status;
+}
+
+mediaController::mediaController(Board board)
+{
+    topology = nullptr;
+    fd = -1;
+    fallbackSensorFd = -1;
+
+    for (const mediaTopology &entry : topologies) {
+        if (entry.board == board)
+            topology = &entry;
+    }
+}
+
+mediaController::~mediaController()
+{
+    for (const auto &subdev : subdevFds)
+        close(subdev.second);
+
+    if (fallbackSensorFd != -1)
+        close(fallbackSensorFd);
+
+    if (fd != -1)
+        close(fd);
+}
+
+/* Open the media device and list its entities, only done the first time */
+bool mediaController::openDevice()
+{
+    struct media_entity_desc description;
+
+    if (fd != -1)
+        return true;
+
+    fd = open(MEDIA_DEVICE, O_RDWR);
+
+    if (fd == -1) {
+        qWarning() << "Could not open file:" << MEDIA_DEVICE;
+        return false;
+    }
+
+    memset(&description, 0, sizeof(description));
+    description.id = MEDIA_ENT_ID_FLAG_NEXT;
+
+    while (xioctl(fd, MEDIA_IOC_ENUM_ENTITIES, &description) == 0) {
+        mediaEntity entity;
+
+        entity.id = description.id;
+        entity.type = description.type;
+        entity.name = description.name;
+        entity.major = description.dev.major;
+        entity.minor = description.dev.minor;
+        entity.pads = description.pads;
+        entity.links = description.links;
+        entities.push_back(entity);
+
+        description.id |= MEDIA_ENT_ID_FLAG_NEXT;
+    }
+
+    return true;
+}
+
+const mediaController::mediaEntity* mediaController::findEntity(const char *name)
+{
+    for (const mediaEntity &entity : entities) {
+        if (entity.name == name)
+            return &entity;
+    }
+
+    qWarning() << "Media entity not found:" << name;
+
+    return nullptr;
+}
+
+const mediaController::mediaEntity* mediaController::findEntity(__u32 id)
+{
+    for (const mediaEntity &entity : entities) {
+        if (entity.id == id)
+            return &entity;
+    }
+
+    return nullptr;
+}
+
+/* The links starting from one of the entity's pads */
+std::vector<mediaController::mediaLink> mediaController::getLinks(const mediaEntity &entity)
+{
+    std::vector<media_pad_desc> padDescriptions(entity.pads);
+    std::vector<media_link_desc> linkDescriptions(entity.links);
+    std::vector<mediaLink> links;
+    struct media_links_enum linksEnum;
+
+    memset(&linksEnum, 0, sizeof(linksEnum));
+    linksEnum.entity = entity.id;
+    linksEnum.pads = padDescriptions.data();
+    linksEnum.links = linkDescriptions.data();
+
+    if (xioctl(fd, MEDIA_IOC_ENUM_LINKS, &linksEnum) == -1) {
+        qWarning() << "MEDIA_IOC_ENUM_LINKS, errno:" << errno;
+        return links;
+    }
+
+    for (const media_link_desc &description : linkDescriptions) {
+        if (description.source.entity != entity.id)
+            continue;
+
+        links.push_back({description.source.entity, description.source.index,
+                         description.sink.entity, description.sink.index, description.flags});
+    }
+
+    return links;
+}
+
+bool mediaController::setupLink(const mediaLink &link, __u32 flags)
+{
+    struct media_link_desc description;
+
+    memset(&description, 0, sizeof(description));
+    description.source.entity = link.sourceEntity;
+    description.source.index = link.sourcePad;
+    description.source.flags = MEDIA_PAD_FL_SOURCE;
+    description.sink.entity = link.sinkEntity;
+    description.sink.index = link.sinkPad;
+    description.sink.flags = MEDIA_PAD_FL_SINK;
+    description.flags = flags;
+
+    if (xioctl(fd, MEDIA_IOC_SETUP_LINK, &description) == -1) {
+        qWarning() << "MEDIA_IOC_SETUP_LINK, errno:" << errno;
+        return false;
+    }
+
+    return true;
+}
+
+/* Disable every enabled link that is not immutable, as "media-ctl -r" does */
+bool mediaController::resetLinks()
+{
+    bool success = true;
+
+    for (const mediaEntity &entity : entities) {
+        for (const mediaLink &link : getLinks(entity)) {
+            if ((link.flags & MEDIA_LNK_FL_IMMUTABLE) || !(link.flags & MEDIA_LNK_FL_ENABLED))
+                continue;
+
+            success &= setupLink(link, link.flags & ~MEDIA_LNK_FL_ENABLED);
+        }
+    }
+
+    return success;
+}
+
+/* Sub-devices are opened through the node udev created for their device number */
+int mediaController::getSubdevFd(const mediaEntity &entity)
+{
+    QFile uevent(QString("/sys/dev/char/%1:%2/uevent").arg(entity.major).arg(entity.minor));
+    QString deviceName;
+    int subdevFd;
+
+    if (subdevFds.count(entity.id))
+        return subdevFds[entity.id];
+
+    if (!uevent.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Could not find the device node of" << entity.name.c_str();
+        return -1;
+    }
+
+    for (const QByteArray &line : uevent.readAll().split('\n')) {
+        if (line.startsWith("DEVNAME="))
+            deviceName = "/dev/" + QString(line.mid(8));
+    }
+
+    subdevFd = open(deviceName.toStdString().c_str(), O_RDWR);
+
+    if (subdevFd == -1) {
+        qWarning() << "Could not open file:" << deviceName;
+        return -1;
+    }
+
+    subdevFds[entity.id] = subdevFd;
+
+    return subdevFd;
+}
+
+/*
+ * Set the format of a pad and, like "media-ctl -V", of the sub-device pads
+ * its enabled links lead to
+ */
+bool mediaController::setPadFormat(const mediaEntity &entity, __u16 pad, unsigned int width, unsigned int height)
+{
+    struct v4l2_subdev_format format;
+    int subdevFd = getSubdevFd(entity);
+
+    if (subdevFd == -1)
+        return false;
+
+    memset(&format, 0, sizeof(format));
+    format.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+    format.pad = pad;
+    format.format.width = width;
+    format.format.height = height;
+    format.format.code = MEDIA_BUS_FMT_UYVY8_2X8;
+    format.format.field = V4L2_FIELD_NONE;
+
+    if (xioctl(subdevFd, VIDIOC_SUBDEV_S_FMT, &format) == -1) {
+        qWarning() << "VIDIOC_SUBDEV_S_FMT on" << entity.name.c_str() << "errno:" << errno;
+        return false;
+    }
+
+    if (format.format.width != width || format.format.height != height)
+        qWarning() << entity.name.c_str() << "uses" << format.format.width << "x" << format.format.height
+                   << "instead of" << width << "x" << height;
+
+    for (const mediaLink &link : getLinks(entity)) {
+        const mediaEntity *sink = findEntity(link.sinkEntity);
+
+        if (link.sourcePad != pad || !(link.flags & MEDIA_LNK_FL_ENABLED) || sink == nullptr ||
+            (sink->type & MEDIA_ENT_TYPE_MASK) != MEDIA_ENT_T_V4L2_SUBDEV)
+            continue;
+
+        format.pad = link.sinkPad;
+
+        if (xioctl(getSubdevFd(*sink), VIDIOC_SUBDEV_S_FMT, &format) == -1)
+            qWarning() << "VIDIOC_SUBDEV_S_FMT on" << sink->name.c_str() << "errno:" << errno;
+    }
+
+    return true;
+}
+
+/*
+ * Link the CSI-2 bridge to the video node and set the capture size on the
+ * bridge's source pad and the sensor, from which it propagates to the
+ * bridge's sink pad
+ */
+bool mediaController::configure(unsigned int width, unsigned int height)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const mediaEntity *bridge, *video, *sensor;
+    bool success;
+
+    if (topology == nullptr) {
+        qWarning("No media pipeline known for this board");
+        return false;
+    }
+
+    if (!openDevice())
+        return false;
+
+    bridge = findEntity(topology->bridgeEntity);
+    video = findEntity(topology->videoEntity);
+    sensor = findEntity(topology->sensorEntity);
+
+    if (bridge == nullptr || video == nullptr || sensor == nullptr)
+        return false;
+
+    success = resetLinks() &&
+              setupLink({bridge->id, 1, video->id, 0, 0}, MEDIA_LNK_FL_ENABLED) &&
+              setPadFormat(*bridge, 1, width, height) &&
+              setPadFormat(*sensor, 0, width, height);
+
+    qInfo("Media pipeline configured in %.1f ms",
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    return success;
+}
+
+/* The sensor's sub-device, for its controls */
+int mediaController::getSensorFd()
+{
+    const mediaEntity *sensor = nullptr;
+
+    if (topology != nullptr && openDevice())
+        sensor = findEntity(topology->sensorEntity);
+
+    if (sensor != nullptr)
+        return getSubdevFd(*sensor);
+
+    if (fallbackSensorFd == -1)
+        fallbackSensorFd = open(MEDIA_FALLBACK_SENSOR_SUBDEV, O_RDWR);
+
+    if (fallbackSensorFd == -1)
+        qWarning("Warning: Failed to open node (" MEDIA_FALLBACK_SENSOR_SUBDEV ")");
+
+    return fallbackSensorFd;
+}
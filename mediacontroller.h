@@ -0,0 +1,93 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef MEDIACONTROLLER_H
+#define MEDIACONTROLLER_H
+
+#define MEDIA_DEVICE "/dev/media0"
+/* Sensor controls are set here when the sensor is not found in the graph */
+#define MEDIA_FALLBACK_SENSOR_SUBDEV "/dev/v4l-subdev1"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <linux/types.h>
+
+enum Board { G2E, G2L, G2M, Unknown };
+
+/* Entities making up the MIPI capture pipeline of a board */
+struct mediaTopology {
+    Board board;
+    const char *bridgeEntity;
+    const char *videoEntity;
+    const char *sensorEntity;
+};
+
+/*
+ * Configures the MIPI camera's media pipeline in process, the way
+ * "media-ctl -r", "media-ctl -l" and "media-ctl -V" would: every link that
+ * can be is disabled, the CSI-2 bridge is linked to the video node and the
+ * sensor and bridge pads are given the capture format. The media device and
+ * the sub-device nodes stay open, so a reconnect only costs the ioctls and the
+ * sensor's controls can be set without reopening it
+ */
+class mediaController
+{
+public:
+    mediaController(Board board);
+    ~mediaController();
+    bool configure(unsigned int width, unsigned int height);
+    int getSensorFd();
+
+private:
+    struct mediaEntity {
+        __u32 id;
+        __u32 type;
+        std::string name;
+        __u32 major;
+        __u32 minor;
+        __u16 pads;
+        __u16 links;
+    };
+
+    struct mediaLink {
+        __u32 sourceEntity;
+        __u16 sourcePad;
+        __u32 sinkEntity;
+        __u16 sinkPad;
+        __u32 flags;
+    };
+
+    bool openDevice();
+    const mediaEntity* findEntity(const char *name);
+    const mediaEntity* findEntity(__u32 id);
+    std::vector<mediaLink> getLinks(const mediaEntity &entity);
+    bool setupLink(const mediaLink &link, __u32 flags);
+    bool resetLinks();
+    bool setPadFormat(const mediaEntity &entity, __u16 pad, unsigned int width, unsigned int height);
+    int getSubdevFd(const mediaEntity &entity);
+
+    const mediaTopology *topology;
+    int fd;
+    int fallbackSensorFd;
+    std::vector<mediaEntity> entities;
+    std::map<__u32, int> subdevFds;
+};
+
+#endif // MEDIACONTROLLER_H
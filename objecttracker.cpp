@@ -0,0 +1,180 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <algorithm>
+
+#include "objecttracker.h"
+
+static float intersectionOverUnion(const detection &first, const detection &second)
+{
+    float width = std::min(first.xmax, second.xmax) - std::max(first.xmin, second.xmin);
+    float height = std::min(first.ymax, second.ymax) - std::max(first.ymin, second.ymin);
+    float intersection, firstArea, secondArea;
+
+    if (width <= 0.0f || height <= 0.0f)
+        return 0.0f;
+
+    intersection = width * height;
+    firstArea = (first.xmax - first.xmin) * (first.ymax - first.ymin);
+    secondArea = (second.xmax - second.xmin) * (second.ymax - second.ymin);
+
+    return intersection / (firstArea + secondArea - intersection);
+}
+
+objectTracker::objectTracker(int maximumInterval) :
+    maximumInterval(std::max(maximumInterval, 1))
+{
+    reset();
+}
+
+void objectTracker::reset()
+{
+    tracks.clear();
+    interval = 1;
+    confidence = 0.0f;
+}
+
+detection objectTracker::predictBox(const track &object, quint64 sequence) const
+{
+    detection box = object.box;
+    float frames;
+
+    if (sequence <= object.sequence)
+        return box;
+
+    /* Stop extrapolating once a track has not been seen for a while */
+    frames = float(std::min<quint64>(sequence - object.sequence, TRACK_MAX_PREDICTION));
+
+    box.ymin += object.velocity[0] * frames;
+    box.xmin += object.velocity[1] * frames;
+    box.ymax += object.velocity[2] * frames;
+    box.xmax += object.velocity[3] * frames;
+
+    return box;
+}
+
+/*
+ * Match the detections found in frame sequence against the tracks, most
+ * overlapping pairs first. Matched tracks take the detected box and blend the
+ * movement since their last detection into their velocity, unmatched tracks
+ * are dropped after TRACK_MAX_MISSES detector runs and unmatched detections
+ * start new tracks
+ */
+void objectTracker::update(const detectionList &detections, quint64 sequence)
+{
+    struct candidatePair {
+        float overlap;
+        size_t track;
+        size_t detection;
+    };
+
+    std::vector<candidatePair> pairs;
+    std::vector<bool> matchedTracks(tracks.size(), false);
+    std::vector<bool> matchedDetections(detections.size(), false);
+    size_t previousTracks = tracks.size();
+    float totalOverlap = 0.0f;
+
+    for (size_t i = 0; i < tracks.size(); i++) {
+        detection predicted = predictBox(tracks[i], sequence);
+
+        for (size_t j = 0; j < detections.size(); j++) {
+            float overlap;
+
+            if (detections[j].item != predicted.item)
+                continue;
+
+            overlap = intersectionOverUnion(predicted, detections[j]);
+
+            if (overlap >= TRACK_MATCH_IOU)
+                pairs.push_back({overlap, i, j});
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end(), [](const candidatePair &first, const candidatePair &second) {
+        return first.overlap > second.overlap;
+    });
+
+    for (const candidatePair &pair : pairs) {
+        track &object = tracks[pair.track];
+        const detection &found = detections[pair.detection];
+
+        if (matchedTracks[pair.track] || matchedDetections[pair.detection])
+            continue;
+
+        matchedTracks[pair.track] = true;
+        matchedDetections[pair.detection] = true;
+        totalOverlap += pair.overlap;
+
+        if (sequence > object.sequence) {
+            float frames = float(sequence - object.sequence);
+            float moved[4] = {found.ymin - object.box.ymin, found.xmin - object.box.xmin,
+                              found.ymax - object.box.ymax, found.xmax - object.box.xmax};
+
+            for (int corner = 0; corner < 4; corner++)
+                object.velocity[corner] += TRACK_VELOCITY_SMOOTHING * (moved[corner] / frames - object.velocity[corner]);
+
+            object.sequence = sequence;
+        }
+
+        object.box = found;
+        object.misses = 0;
+    }
+
+    for (size_t i = tracks.size(); i-- > 0;) {
+        if (!matchedTracks[i] && ++tracks[i].misses > TRACK_MAX_MISSES)
+            tracks.erase(tracks.begin() + long(i));
+    }
+
+    for (size_t j = 0; j < detections.size(); j++) {
+        if (!matchedDetections[j])
+            tracks.push_back({detections[j], {0.0f, 0.0f, 0.0f, 0.0f}, sequence, 0});
+    }
+
+    /* Every unmatched track or detection counts as a complete miss */
+    if (previousTracks == 0 && detections.empty())
+        confidence = 1.0f;
+    else
+        confidence = totalOverlap / float(std::max(previousTracks, detections.size()));
+
+    if (confidence >= TRACK_CONFIDENCE_HIGH)
+        interval = std::min(interval + 1, maximumInterval);
+    else if (confidence < TRACK_CONFIDENCE_LOW)
+        interval = 1;
+}
+
+/*
+ * Write the predicted boxes of every track at frame sequence to output.
+ * Tracks the detector has just missed are kept, which hides its flicker
+ */
+void objectTracker::predict(quint64 sequence, detectionList &output) const
+{
+    output.clear();
+
+    for (const track &object : tracks)
+        output.push_back(predictBox(object, sequence));
+}
+
+int objectTracker::getInterval() const
+{
+    return interval;
+}
+
+float objectTracker::getConfidence() const
+{
+    return confidence;
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+#ifndef OBJECTTRACKER_H
+#define OBJECTTRACKER_H
+
+#define TRACK_MATCH_IOU 0.3f
+#define TRACK_MAX_MISSES 2
+#define TRACK_MAX_PREDICTION 30
+#define TRACK_VELOCITY_SMOOTHING 0.5f
+#define TRACK_CONFIDENCE_HIGH 0.7f
+#define TRACK_CONFIDENCE_LOW 0.4f
+
+#include <QtGlobal>
+
+#include <vector>
+
+#include "detectionresult.h"
+
+/*
+ * Carries the detector's boxes across the frames it is not run on. Each box
+ * is a track with a constant velocity, associated with the next detections
+ * of the same item by greedy IoU matching. Positions are a function of the
+ * frame sequence number, so detections that arrive several frames late
+ * still update the tracks at the frame they were found in.
+ *
+ * The agreement between the predicted and detected boxes drives how many
+ * frames are left between detector runs, from 1 up to the maximum interval
+ */
+class objectTracker
+{
+public:
+    explicit objectTracker(int maximumInterval);
+    void reset();
+    void update(const detectionList &detections, quint64 sequence);
+    void predict(quint64 sequence, detectionList &output) const;
+    int getInterval() const;
+    float getConfidence() const;
+
+private:
+    struct track {
+        detection box;
+        float velocity[4];
+        quint64 sequence;
+        int misses;
+    };
+
+    detection predictBox(const track &object, quint64 sequence) const;
+
+    std::vector<track> tracks;
+    int interval;
+    int maximumInterval;
+    float confidence;
+};
+
+#endif // OBJECTTRACKER_H
@@ -24,24 +24,51 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+#include "latencystats.h"
 #include "opencvworker.h"
+#include "v4l2camera.h"
 
 #include <opencv2/imgproc/imgproc.hpp>
 
-opencvWorker::opencvWorker(QString cameraLocation, Board board)
+opencvWorker::opencvWorker(QString cameraLocation, Board board, bool nativeV4l2,
+                           const captureSettings &settings)
 {
     webcamName = cameraLocation.toStdString();
     connectionAttempts = 0;
+    useNativeV4l2 = nativeV4l2;
+    cameraSettings = settings;
+    compressedFrames = false;
+    camera = nullptr;
+    writeIndex = 0;
+    publishedIndex = 1;
+    readIndex = 2;
+    newFrameAvailable = false;
+    frameSequence = 0;
+
+    for (capturedFrame &frame : frameRing)
+        frame.sequence = 0;
+
+    capturing = false;
+    captureFailed = false;
 
     setupCamera();
 
+    cameraWidth = cameraSettings.width > 0 ? cameraSettings.width
+                                           : (usingMipi ? CAMERA_MIPI_WIDTH : CAMERA_USB_WIDTH);
+    cameraHeight = cameraSettings.height > 0 ? cameraSettings.height
+                                             : (usingMipi ? CAMERA_MIPI_HEIGHT : CAMERA_USB_HEIGHT);
+
+    if (!usingMipi && cameraSettings.frameRate <= 0)
+        cameraSettings.frameRate = CAMERA_USB_FPS;
+
     if (usingMipi) {
-        if (board == G2M)
-            cameraInitialization = G2M_CAM_INIT;
-        else if (board == G2E)
-            cameraInitialization = G2E_CAM_INIT;
-        else if (board == G2L)
-            cameraInitialization = G2L_CAM_INIT;
+        /* The OV5645 only streams UYVY over CSI-2 */
+        if (cameraSettings.format != CAPTURE_FORMAT_UYVY) {
+            qWarning("The MIPI camera only supports UYVY, ignoring the capture format");
+            cameraSettings.format = CAPTURE_FORMAT_UYVY;
+        }
+
+        mediaPipeline.reset(new mediaController(board));
     }
 
     connectCamera();
@@ -57,40 +84,9 @@ opencvWorker::opencvWorker(QString cameraLocation, Board board)
         toggleGain();
         toggleExpose();
     }
-}
-
-int opencvWorker::runCommand(std::string command, std::string &stdoutput)
-{
-    size_t charsRead;
-    int status;
-    char buffer[512];
-
-    FILE *output = popen(command.c_str(), "r");
-
-    if (output == NULL)
-        qWarning("cannot execute command");
-
-    stdoutput = "";
-    while (true) {
-        charsRead = fread(buffer, sizeof(char), sizeof(buffer), output);
-
-        if (charsRead > 0)
-            stdoutput += std::string(buffer, charsRead);
-
-        if (ferror(output)) {
-            pclose(output);
-            qWarning("Could not retreive output from command");
-        }
-
-        if (feof(output))
-            break;
-    }
 
-    status = pclose(output);
-    if (status == -1)
-        qWarning("Could not terminate from command");
-
-    return WEXITSTATUS(status);
+    if (webcamInitialised && webcamOpened)
+        startCapture();
 }
 
 void opencvWorker::setupCamera()
@@ -126,20 +122,16 @@ void opencvWorker::setControl(__u32 id, __s32 value)
 
     if (usingMipi) {
         struct v4l2_control control;
-        int fd = open("/dev/v4l-subdev1", O_RDWR);
+        int fd = mediaPipeline->getSensorFd();
 
-        if (fd <= 0) {
-            qWarning("Warning: Failed to open node (/dev/v4l-subdev1)");
+        if (fd == -1)
             return;
-        }
 
         control.id = id;
         control.value = value;
 
         if (ioctl(fd, VIDIOC_S_CTRL, &control) == -1)
             qWarning() << "VIDIOC_S_CTRL, errno:" << errno;
-
-        close(fd);
     }
 }
 
@@ -168,20 +160,30 @@ void opencvWorker::toggleExpose()
 void opencvWorker::connectCamera()
 {
     connectionAttempts++;
-    int cameraWidth = 800;
-    int cameraHeight = 600;
+    int fourcc;
 
-    if (usingMipi) {
-        std::string stdoutput;
+    if (usingMipi && !mediaPipeline->configure(unsigned(cameraWidth), unsigned(cameraHeight)))
+        qWarning("Cannot initialize the camera");
 
-        /* Run media-ctl command */
-        if (runCommand(cameraInitialization, stdoutput))
-            qWarning("Cannot initialize the camera");
+    if (useNativeV4l2) {
+        connectNativeCamera();
+
+        if (useNativeV4l2) {
+            checkCamera();
+            return;
+        }
     }
 
+    if (cameraSettings.format == CAPTURE_FORMAT_MJPEG)
+        fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+    else if (cameraSettings.format == CAPTURE_FORMAT_YUYV)
+        fourcc = cv::VideoWriter::fourcc('Y', 'U', 'Y', 'V');
+    else
+        fourcc = cv::VideoWriter::fourcc('U', 'Y', 'V', 'Y');
+
     /* Define the format for the camera to use */
     camera = new cv::VideoCapture(webcamName);
-    camera->set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('U', 'Y', 'V', 'Y'));
+    camera->set(cv::CAP_PROP_FOURCC, fourcc);
     camera->open(webcamName);
 
     if (!camera->isOpened()) {
@@ -191,27 +193,160 @@ void opencvWorker::connectCamera()
         webcamOpened = true;
     }
 
-    if (!usingMipi) {
-        camera->set(cv::CAP_PROP_FPS, 10);
+    if (cameraSettings.frameRate > 0)
+        camera->set(cv::CAP_PROP_FPS, cameraSettings.frameRate);
+
+    if (!usingMipi)
         camera->set(cv::CAP_PROP_BUFFERSIZE, 1);
-        cameraWidth = 1280;
-        cameraHeight = 720;
-    }
 
     camera->set(cv::CAP_PROP_FRAME_WIDTH, cameraWidth);
     camera->set(cv::CAP_PROP_FRAME_HEIGHT, cameraHeight);
 
+    /* Ask for the JPEG data itself so it can be decoded at a reduced scale,
+     * backends that cannot provide it hand over decoded BGR frames instead */
+    if (cameraSettings.format == CAPTURE_FORMAT_MJPEG) {
+        camera->set(cv::CAP_PROP_CONVERT_RGB, 0);
+        compressedFrames = true;
+    }
+
     checkCamera();
 }
 
+/*
+ * Open the camera through the native V4L2 backend. Falls back to
+ * cv::VideoCapture if the driver provides neither a packed YUV 4:2:2 format
+ * nor MJPEG
+ */
+void opencvWorker::connectNativeCamera()
+{
+    __u32 pixelFormat = V4L2_PIX_FMT_UYVY;
+
+    if (cameraSettings.format == CAPTURE_FORMAT_MJPEG)
+        pixelFormat = V4L2_PIX_FMT_MJPEG;
+    else if (cameraSettings.format == CAPTURE_FORMAT_YUYV)
+        pixelFormat = V4L2_PIX_FMT_YUYV;
+
+    if (!nativeCamera)
+        nativeCamera.reset(new v4l2Camera(webcamName));
+
+    webcamOpened = nativeCamera->open(unsigned(cameraWidth), unsigned(cameraHeight), pixelFormat,
+                                      unsigned(qMax(cameraSettings.frameRate, 0)));
+
+    if (!webcamOpened) {
+        qWarning("Cannot open the camera");
+        return;
+    }
+
+    compressedFrames = nativeCamera->isCompressed();
+
+    if (nativeCamera->getPixelFormat() == V4L2_PIX_FMT_UYVY) {
+        nativeConversion = cv::COLOR_YUV2RGB_UYVY;
+    } else if (nativeCamera->getPixelFormat() == V4L2_PIX_FMT_YUYV) {
+        nativeConversion = cv::COLOR_YUV2RGB_YUYV;
+    } else if (!compressedFrames) {
+        qWarning("Unsupported v4l2 pixel format, falling back to OpenCV capture");
+        nativeCamera->release();
+        useNativeV4l2 = false;
+    }
+}
+
+/*
+ * Retrieve the next frame from the camera as RGB. The native backend converts
+ * straight out of the mapped driver buffer, avoiding the intermediate BGR frame
+ * produced by cv::VideoCapture
+ */
+bool opencvWorker::readFrame(cv::Mat &image)
+{
+    if (useNativeV4l2) {
+        cv::Mat rawFrame;
+        unsigned int index;
+
+        {
+            stageTimer timer(STAGE_CAPTURE);
+
+            if (!nativeCamera->isOpened() || !nativeCamera->dequeueFrame(rawFrame, index))
+                return false;
+        }
+
+        if (compressedFrames) {
+            bool decoded = decodeFrame(rawFrame, image);
+
+            nativeCamera->queueFrame(index);
+            return decoded;
+        }
+
+        {
+            stageTimer timer(STAGE_COLOUR_CONVERSION);
+
+            cv::cvtColor(rawFrame, image, nativeConversion);
+        }
+
+        nativeCamera->queueFrame(index);
+
+        return true;
+    }
+
+    if (compressedFrames) {
+        {
+            stageTimer timer(STAGE_CAPTURE);
+
+            *camera >> jpegFrame;
+        }
+
+        return decodeFrame(jpegFrame, image);
+    }
+
+    {
+        stageTimer timer(STAGE_CAPTURE);
+
+        *camera >> image;
+    }
+
+    if (image.empty())
+        return false;
+
+    stageTimer timer(STAGE_COLOUR_CONVERSION);
+
+    cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+
+    return true;
+}
+
+/*
+ * Decode an MJPEG frame to RGB at the requested scale. A frame that is not a
+ * single row of bytes has already been decoded to BGR by cv::VideoCapture
+ */
+bool opencvWorker::decodeFrame(const cv::Mat &compressed, cv::Mat &image)
+{
+    if (compressed.empty())
+        return false;
+
+    if (compressed.rows != 1) {
+        stageTimer timer(STAGE_COLOUR_CONVERSION);
+
+        cv::cvtColor(compressed, image, cv::COLOR_BGR2RGB);
+        return true;
+    }
+
+    stageTimer timer(STAGE_JPEG_DECODE);
+
+    return jpeg.decode(compressed.data, compressed.total(), cameraSettings.jpegScale, image);
+}
+
+void opencvWorker::releaseCamera()
+{
+    if (useNativeV4l2)
+        nativeCamera->release();
+    else if (camera != nullptr)
+        camera->release();
+}
+
 void opencvWorker::checkCamera()
 {
     /* Check to see if camera can retrieve a frame*/
-    *camera >> picture;
-
-    if (picture.empty()) {
+    if (!readFrame(picture)) {
         qWarning("Lost connection to camera, reconnecting");
-        camera->release();
+        releaseCamera();
 
         if (connectionAttempts < 3) {
             connectCamera();
@@ -223,24 +358,131 @@ void opencvWorker::checkCamera()
 }
 
 opencvWorker::~opencvWorker() {
-    camera->release();
+    stopCapture();
+    releaseCamera();
+}
+
+/*
+ * Start dequeuing frames on a dedicated thread. The frame retrieved by
+ * checkCamera() is published straight away so that a reader always has
+ * a valid frame to work with
+ */
+void opencvWorker::startCapture()
+{
+    capturedFrame &firstFrame = frameRing[publishedIndex];
+
+    picture.copyTo(firstFrame.image);
+    firstFrame.sequence = ++frameSequence;
+    firstFrame.timestamp = std::chrono::steady_clock::now();
+    newFrameAvailable = true;
+
+    capturing = true;
+    captureThread = std::thread(&opencvWorker::captureLoop, this);
+}
+
+void opencvWorker::stopCapture()
+{
+    capturing = false;
+
+    if (captureThread.joinable())
+        captureThread.join();
 }
 
-cv::Mat* opencvWorker::getImage(unsigned int iterations)
+/*
+ * Keep the camera buffers drained by continuously writing into the free slot
+ * of the frame ring, then swap it with the published slot. The reader never
+ * waits on the camera and always receives the newest frame
+ */
+void opencvWorker::captureLoop()
 {
-    do {
-        *camera >> picture;
+    while (capturing) {
+        capturedFrame &frame = frameRing[writeIndex];
 
-        if (picture.empty()) {
+        if (!readFrame(frame.image)) {
             qWarning("Image retrieval error");
-            return nullptr;
+            captureFailed = true;
+            frameCondition.notify_all();
+            break;
+        }
+
+        frame.timestamp = std::chrono::steady_clock::now();
+        frame.sequence = ++frameSequence;
+
+        {
+            std::lock_guard<std::mutex> lock(ringMutex);
+            std::swap(writeIndex, publishedIndex);
+            newFrameAvailable = true;
         }
 
-    } while (--iterations);
+        frameCondition.notify_all();
+    }
+}
+
+/*
+ * Return the newest frame published by the capture thread. The returned frame
+ * stays valid until the next call, as the capture thread never writes to the
+ * slot held by the reader
+ */
+const capturedFrame* opencvWorker::getFrame()
+{
+    std::lock_guard<std::mutex> lock(ringMutex);
+
+    if (captureFailed)
+        return nullptr;
+
+    if (newFrameAvailable) {
+        std::swap(readIndex, publishedIndex);
+        newFrameAvailable = false;
+    }
+
+    return &frameRing[readIndex];
+}
+
+/*
+ * Block until a frame newer than lastSequence has been published and copy it.
+ * Unlike getFrame() the copy belongs to the caller, so any number of consumer
+ * threads can use this alongside the GUI thread
+ */
+bool opencvWorker::waitForFrame(quint64 lastSequence, capturedFrame &frame, unsigned int timeoutMS)
+{
+    std::unique_lock<std::mutex> lock(ringMutex);
+    bool published;
+
+    published = frameCondition.wait_for(lock, std::chrono::milliseconds(timeoutMS), [&]() {
+        return captureFailed || (newFrameAvailable ? frameRing[publishedIndex].sequence
+                                                   : frameRing[readIndex].sequence) > lastSequence;
+    });
+
+    if (!published || captureFailed)
+        return false;
+
+    /* The newest frame is the published slot, unless the GUI thread has
+     * already taken it into the slot it is reading from */
+    const capturedFrame &newest = newFrameAvailable ? frameRing[publishedIndex] : frameRing[readIndex];
+
+    newest.image.copyTo(frame.image);
+    frame.sequence = newest.sequence;
+    frame.timestamp = newest.timestamp;
 
-    cv::cvtColor(picture, picture, cv::COLOR_BGR2RGB);
+    return true;
+}
+
+/* Sequence number of the newest frame, whether or not it has been read */
+quint64 opencvWorker::getPublishedSequence()
+{
+    std::lock_guard<std::mutex> lock(ringMutex);
 
-    return &picture;
+    return newFrameAvailable ? frameRing[publishedIndex].sequence : frameRing[readIndex].sequence;
+}
+
+const cv::Mat* opencvWorker::getImage()
+{
+    const capturedFrame *frame = getFrame();
+
+    if (frame == nullptr)
+        return nullptr;
+
+    return &frame->image;
 }
 
 bool opencvWorker::getUsingMipi()
@@ -248,6 +490,11 @@ bool opencvWorker::getUsingMipi()
     return usingMipi;
 }
 
+bool opencvWorker::getCaptureFailed()
+{
+    return captureFailed;
+}
+
 bool opencvWorker::cameraInit()
 {
     return webcamInitialised;
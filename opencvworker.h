@@ -19,47 +19,91 @@
 #ifndef OPENCVCAPTUREWORKER_H
 #define OPENCVCAPTUREWORKER_H
 
-#define G2L_CAM_INIT "media-ctl -d /dev/media0 --reset && media-ctl -d /dev/media0 -l \"'rzg2l_csi2 10830400.csi2':1->'CRU output':0 [1]\" && media-ctl -d /dev/media0 -V \"'rzg2l_csi2 10830400.csi2':1 [fmt:UYVY8_2X8/800x600 field:none]\" && media-ctl -d /dev/media0 -V \"'ov5645 0-003c':0 [fmt:UYVY8_2X8/800x600 field:none]\""
-#define G2M_CAM_INIT "media-ctl -d /dev/media0 -r && media-ctl -d /dev/media0 -l \"'rcar_csi2 fea80000.csi2':1->'VIN0 output':0 [1]\" && media-ctl -d /dev/media0 -V \"'rcar_csi2 fea80000.csi2':1 [fmt:UYVY8_2X8/800x600 field:none]\" && media-ctl -d /dev/media0 -V \"'ov5645 2-003c':0 [fmt:UYVY8_2X8/800x600 field:none]\""
-#define G2E_CAM_INIT "media-ctl -d /dev/media0 -r && media-ctl -d /dev/media0 -l \"'rcar_csi2 feaa0000.csi2':1->'VIN4 output':0 [1]\" && media-ctl -d /dev/media0 -V \"'rcar_csi2 feaa0000.csi2':1 [fmt:UYVY8_2X8/800x600 field:none]\" && media-ctl -d /dev/media0 -V \"'ov5645 3-003c':0 [fmt:UYVY8_2X8/800x600 field:none]\""
+/* Capture defaults when no size or frame rate is given */
+#define CAMERA_MIPI_WIDTH 800
+#define CAMERA_MIPI_HEIGHT 600
+#define CAMERA_USB_WIDTH 1280
+#define CAMERA_USB_HEIGHT 720
+#define CAMERA_USB_FPS 10
 
 #include <linux/v4l2-controls.h>
 #include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string.h>
+#include <thread>
 
 #include <QObject>
 
+#include "jpegdecoder.h"
+#include "mediacontroller.h"
+
 #include <linux/types.h>
 
+/* Number of preallocated frames shared between the capture thread and its
+ * reader: one being written, one published and one held by the reader */
+#define FRAME_RING_SIZE 3
+
 Q_DECLARE_METATYPE(cv::Mat)
 
-enum Board { G2E, G2L, G2M, Unknown };
+class v4l2Camera;
+
+enum captureFormat { CAPTURE_FORMAT_UYVY, CAPTURE_FORMAT_YUYV, CAPTURE_FORMAT_MJPEG };
+
+struct captureSettings {
+    captureFormat format;
+    /* A size of 0 uses the camera's default, CAMERA_MIPI_* or CAMERA_USB_* */
+    int width;
+    int height;
+    /* 0 keeps the sensor's rate on MIPI and uses CAMERA_USB_FPS on USB */
+    int frameRate;
+    /* MJPEG frames are decoded at 1/jpegScale of their size: 1, 2, 4 or 8 */
+    int jpegScale;
+};
+
+struct capturedFrame {
+    cv::Mat image;
+    quint64 sequence;
+    std::chrono::steady_clock::time_point timestamp;
+};
 
 class opencvWorker : public QObject
 {
     Q_OBJECT
 
 public:
-    opencvWorker(QString cameraLocation, Board board);
+    opencvWorker(QString cameraLocation, Board board, bool nativeV4l2, const captureSettings &settings);
     ~opencvWorker();
-    cv::Mat* getImage(unsigned int iterations);
+    const capturedFrame* getFrame();
+    const cv::Mat* getImage();
+    bool waitForFrame(quint64 lastSequence, capturedFrame &frame, unsigned int timeoutMS);
     bool cameraInit();
     bool getCameraOpen();
     bool getUsingMipi();
+    bool getCaptureFailed();
+    quint64 getPublishedSequence();
     void toggleWhitebalanceAuto();
     void toggleGain();
     void toggleExpose();
     void toggleSaturation();
 
 private:
-    int runCommand(std::string command, std::string &stdoutput);
     void setControl(__u32 id, __s32 value);
     void setupCamera();
     void connectCamera();
+    void connectNativeCamera();
+    bool readFrame(cv::Mat &image);
+    bool decodeFrame(const cv::Mat &compressed, cv::Mat &image);
+    void releaseCamera();
     void checkCamera();
+    void startCapture();
+    void stopCapture();
+    void captureLoop();
 
     std::unique_ptr<cv::VideoCapture> videoCapture;
     bool webcamInitialised;
@@ -69,10 +113,30 @@ private:
     std::string webcamName;
     cv::Mat picture;
     cv::VideoCapture *camera;
-    std::string cameraInitialization;
+    std::unique_ptr<v4l2Camera> nativeCamera;
+    bool useNativeV4l2;
+    int nativeConversion;
+    captureSettings cameraSettings;
+    int cameraWidth;
+    int cameraHeight;
+    bool compressedFrames;
+    cv::Mat jpegFrame;
+    jpegDecoder jpeg;
+    std::unique_ptr<mediaController> mediaPipeline;
     bool autoWhiteBalance;
     bool autoGain;
     v4l2_exposure_auto_type autoExpose;
+    capturedFrame frameRing[FRAME_RING_SIZE];
+    unsigned int writeIndex;
+    unsigned int publishedIndex;
+    unsigned int readIndex;
+    bool newFrameAvailable;
+    quint64 frameSequence;
+    std::mutex ringMutex;
+    std::condition_variable frameCondition;
+    std::thread captureThread;
+    std::atomic<bool> capturing;
+    std::atomic<bool> captureFailed;
 };
 
 #endif // OPENCVCAPTUREWORKER_H
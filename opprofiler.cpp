@@ -0,0 +1,162 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include "opprofiler.h"
+
+opProfiler::opProfiler(tflite::Interpreter *profiledInterpreter) :
+    interpreter(profiledInterpreter)
+{
+}
+
+/*
+ * Only operator events are timed, a handle of 0 marks the runtime events that
+ * are ignored. Operator events from a delegate arrive nested inside the
+ * delegate's own node
+ */
+uint32_t opProfiler::BeginEvent(const char *tag, EventType eventType,
+                                int64_t eventMetadata1, int64_t eventMetadata2)
+{
+    activeEvent event;
+
+    if (eventType != EventType::OPERATOR_INVOKE_EVENT && eventType != EventType::DELEGATE_OPERATOR_INVOKE_EVENT)
+        return 0;
+
+    event.tag = tag;
+    event.eventType = eventType;
+    event.node = int(eventMetadata1);
+    event.subgraph = int(eventMetadata2);
+    event.startTime = std::chrono::steady_clock::now();
+    activeEvents.push_back(event);
+
+    return uint32_t(activeEvents.size());
+}
+
+void opProfiler::EndEvent(uint32_t eventHandle)
+{
+    std::chrono::steady_clock::time_point stopTime = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(totalsMutex);
+
+    if (eventHandle == 0 || eventHandle > activeEvents.size())
+        return;
+
+    activeEvent &event = activeEvents[eventHandle - 1];
+    std::pair<int, int> key(int(event.eventType), event.node);
+    std::map<std::pair<int, int>, opTotals>::iterator entry = totals.find(key);
+
+    /* Only the main subgraph is reported, control flow subgraphs are not used */
+    if (event.subgraph == 0) {
+        if (entry == totals.end()) {
+            opTotals newEntry;
+
+            newEntry.tag = event.tag != nullptr ? event.tag : "unknown";
+            newEntry.eventType = event.eventType;
+            newEntry.node = event.node;
+            newEntry.delegated = event.eventType == EventType::DELEGATE_OPERATOR_INVOKE_EVENT ||
+                                 interpreter->node_and_registration(event.node)->first.delegate != nullptr;
+            newEntry.invocations = 0;
+            newEntry.totalMicroseconds = 0;
+            entry = totals.insert(std::make_pair(key, newEntry)).first;
+        }
+
+        entry->second.invocations++;
+        entry->second.totalMicroseconds += quint64(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   stopTime - event.startTime).count());
+    }
+
+    activeEvents.resize(eventHandle - 1);
+}
+
+std::vector<opProfiler::opTotals> opProfiler::getTotals()
+{
+    std::lock_guard<std::mutex> lock(totalsMutex);
+    std::vector<opTotals> result;
+
+    for (const std::pair<const std::pair<int, int>, opTotals> &entry : totals)
+        result.push_back(entry.second);
+
+    return result;
+}
+
+/*
+ * Append a report ranking the operators by total time to a file. Nodes that
+ * are not delegated ran on the builtin TFLite kernels, so a large share of
+ * time outside the delegate shows ops falling back to the CPU
+ */
+bool opProfiler::writeReport(const QString &fileName, const QString &title, const std::vector<opTotals> &totals)
+{
+    std::vector<opTotals> ranked = totals;
+    QFile file(fileName);
+    QTextStream stream(&file);
+    quint64 operatorTime = 0;
+    quint64 fallbackTime = 0;
+    int operatorNodes = 0;
+    int delegatedNodes = 0;
+    int rank = 1;
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "Could not write the operator profile to" << fileName;
+        return false;
+    }
+
+    std::sort(ranked.begin(), ranked.end(), [](const opTotals &a, const opTotals &b) {
+        return a.totalMicroseconds > b.totalMicroseconds;
+    });
+
+    /* Delegate internal events are already counted in their delegate node */
+    for (const opTotals &op : ranked) {
+        if (op.eventType != EventType::OPERATOR_INVOKE_EVENT)
+            continue;
+
+        operatorNodes++;
+        operatorTime += op.totalMicroseconds;
+
+        if (op.delegated)
+            delegatedNodes++;
+        else
+            fallbackTime += op.totalMicroseconds;
+    }
+
+    stream << "=== " << title << " ===\n";
+    stream << "Execution plan nodes: " << operatorNodes << ", delegated: " << delegatedNodes
+           << ", time outside the delegate: "
+           << QString::number(operatorTime > 0 ? 100.0 * fallbackTime / operatorTime : 0, 'f', 1) << "%\n\n";
+    stream << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n").arg("rank", 4).arg("op", -32).arg("node", 5)
+              .arg("kind", -9).arg("delegated", 9).arg("runs", 7).arg("mean ms", 9).arg("total ms", 10)
+              .arg("share", 6);
+
+    for (const opTotals &op : ranked) {
+        bool delegateEvent = op.eventType == EventType::DELEGATE_OPERATOR_INVOKE_EVENT;
+
+        stream << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9%\n").arg(rank++, 4).arg(QString::fromStdString(op.tag), -32)
+                  .arg(op.node, 5).arg(delegateEvent ? "delegate" : "operator", -9)
+                  .arg(op.delegated ? "yes" : "no", 9).arg(op.invocations, 7)
+                  .arg(op.totalMicroseconds / 1000.0 / std::max(op.invocations, quint64(1)), 9, 'f', 3)
+                  .arg(op.totalMicroseconds / 1000.0, 10, 'f', 1)
+                  .arg(operatorTime > 0 ? 100.0 * op.totalMicroseconds / operatorTime : 0, 5, 'f', 1);
+    }
+
+    stream << "\n";
+
+    return true;
+}
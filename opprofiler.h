@@ -0,0 +1,75 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef OPPROFILER_H
+#define OPPROFILER_H
+
+#include <tensorflow/lite/core/api/profiler.h>
+#include <tensorflow/lite/interpreter.h>
+
+#include <QString>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * TFLite profiler accumulating the time spent in every operator of the
+ * execution plan, and in any per-op events a delegate reports, over all the
+ * invocations it is installed for. Each interpreter needs its own instance
+ * as events are nested on a per-thread stack
+ */
+class opProfiler : public tflite::Profiler
+{
+public:
+    struct opTotals {
+        std::string tag;
+        EventType eventType;
+        int node;
+        bool delegated;
+        quint64 invocations;
+        quint64 totalMicroseconds;
+    };
+
+    explicit opProfiler(tflite::Interpreter *profiledInterpreter);
+    uint32_t BeginEvent(const char *tag, EventType eventType,
+                        int64_t eventMetadata1, int64_t eventMetadata2) override;
+    void EndEvent(uint32_t eventHandle) override;
+    std::vector<opTotals> getTotals();
+    static bool writeReport(const QString &fileName, const QString &title,
+                            const std::vector<opTotals> &totals);
+
+private:
+    struct activeEvent {
+        const char *tag;
+        EventType eventType;
+        int node;
+        int subgraph;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    tflite::Interpreter *interpreter;
+    std::vector<activeEvent> activeEvents;
+    std::mutex totalsMutex;
+    std::map<std::pair<int, int>, opTotals> totals;
+};
+
+#endif // OPPROFILER_H
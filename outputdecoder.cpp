@@ -0,0 +1,352 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#include "outputdecoder.h"
+
+#define DECODER_VECTOR_WIDTH 4
+
+typedef float floatVector __attribute__((vector_size(DECODER_VECTOR_WIDTH * sizeof(float))));
+typedef int intVector __attribute__((vector_size(DECODER_VECTOR_WIDTH * sizeof(int))));
+
+/* True if any of the values is at least the threshold, compared a vector at a time */
+static bool anyAtLeast(const float *values, int count, float threshold)
+{
+    floatVector limit = {threshold, threshold, threshold, threshold};
+    int i = 0;
+
+    for (; i + DECODER_VECTOR_WIDTH <= count; i += DECODER_VECTOR_WIDTH) {
+        floatVector vector;
+        intVector mask;
+
+        memcpy(&vector, values + i, sizeof(vector));
+        mask = vector >= limit;
+
+        if (mask[0] | mask[1] | mask[2] | mask[3])
+            return true;
+    }
+
+    for (; i < count; i++) {
+        if (values[i] >= threshold)
+            return true;
+    }
+
+    return false;
+}
+
+static int findLargest(const float *values, int count)
+{
+    int largest = 0;
+
+    for (int i = 1; i < count; i++) {
+        if (values[i] > values[largest])
+            largest = i;
+    }
+
+    return largest;
+}
+
+int outputDecoder::getMaximumCandidates() const
+{
+    return maximumCandidates;
+}
+
+/* Pick the decoder matching the number and shapes of the model's outputs */
+std::unique_ptr<outputDecoder> outputDecoder::create(const tflite::Model *model)
+{
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+    const flatbuffers::Vector<int32_t> *inputShape = subgraph->tensors()->Get(subgraph->inputs()->Get(0))->shape();
+    std::vector<const flatbuffers::Vector<int32_t>*> shapes;
+
+    for (int32_t output : *subgraph->outputs()) {
+        if (subgraph->tensors()->Get(output)->type() != tflite::TensorType_FLOAT32) {
+            qWarning("Only models with float outputs are supported");
+            return nullptr;
+        }
+
+        shapes.push_back(subgraph->tensors()->Get(output)->shape());
+    }
+
+    if (shapes.size() == 4 && shapes[0]->size() == 3 && shapes[0]->Get(2) == 4 && shapes[2]->size() == 2)
+        return std::unique_ptr<outputDecoder>(new postProcessDecoder(shapes[2]->Get(1)));
+
+    if (shapes.size() == 2 && shapes[0]->size() == 3 && shapes[1]->size() == 3) {
+        int boxOutput = shapes[0]->Get(2) == 4 ? 0 : 1;
+        int scoreOutput = 1 - boxOutput;
+        std::unique_ptr<ssdAnchorDecoder> decoder(new ssdAnchorDecoder(inputShape->Get(1),
+                                                  shapes[boxOutput]->Get(1), shapes[scoreOutput]->Get(2) - 1,
+                                                  boxOutput, scoreOutput));
+
+        if (decoder->isValid())
+            return decoder;
+
+        qWarning("The model's anchors do not match the SSD anchor layout");
+        return nullptr;
+    }
+
+    if (shapes.size() == 1 && shapes[0]->size() == 3) {
+        int rows = shapes[0]->Get(1);
+        int columns = shapes[0]->Get(2);
+
+        /* There are always far more boxes than values per box */
+        if (rows > columns)
+            return std::unique_ptr<outputDecoder>(new yoloDecoder(rows, columns - 5, false));
+        else
+            return std::unique_ptr<outputDecoder>(new yoloDecoder(columns, rows - 4, true));
+    }
+
+    qWarning("Unrecognised model output layout");
+
+    return nullptr;
+}
+
+postProcessDecoder::postProcessDecoder(int detections)
+{
+    maximumCandidates = detections;
+}
+
+const char* postProcessDecoder::getName() const
+{
+    return "TFLite detection post-process";
+}
+
+void postProcessDecoder::decode(tflite::Interpreter *interpreter, float minimumScore, detectionList &candidates) const
+{
+    const float *boxes = interpreter->typed_output_tensor<float>(0);
+    const float *classes = interpreter->typed_output_tensor<float>(1);
+    const float *scores = interpreter->typed_output_tensor<float>(2);
+    /* Only the first count entries are valid, the rest are zero padding */
+    int count = std::min(std::max(int(*interpreter->typed_output_tensor<float>(3)), 0), maximumCandidates);
+
+    for (int i = 0; i < count; i++) {
+        detection item;
+
+        if (scores[i] < minimumScore || scores[i] > float(1.0))
+            continue;
+
+        item.item = int(classes[i]);
+        item.confidence = scores[i];
+        item.ymin = boxes[i * 4];
+        item.xmin = boxes[i * 4 + 1];
+        item.ymax = boxes[i * 4 + 2];
+        item.xmax = boxes[i * 4 + 3];
+        candidates.push_back(item);
+    }
+}
+
+/*
+ * Generate the anchors of the TensorFlow object detection API
+ * multiple_grid_anchor_generator with its default SSD settings. The lowest
+ * layer has three boxes per cell, the others five aspect ratios plus one box
+ * between this layer's scale and the next
+ */
+ssdAnchorDecoder::ssdAnchorDecoder(int inputSize, int anchorCount, int classes, int boxOutput, int scoreOutput) :
+    classCount(classes), boxIndex(boxOutput), scoreIndex(scoreOutput)
+{
+    static const float aspectRatios[] = {1.0f, 2.0f, 0.5f, 3.0f, 1.0f / 3.0f};
+    float scales[SSD_ANCHOR_LAYERS + 1];
+    int stride = 16;
+
+    maximumCandidates = anchorCount;
+
+    for (int layer = 0; layer < SSD_ANCHOR_LAYERS; layer++)
+        scales[layer] = SSD_ANCHOR_MIN_SCALE + (SSD_ANCHOR_MAX_SCALE - SSD_ANCHOR_MIN_SCALE) * layer /
+                        (SSD_ANCHOR_LAYERS - 1);
+
+    scales[SSD_ANCHOR_LAYERS] = 1.0f;
+
+    for (int layer = 0; layer < SSD_ANCHOR_LAYERS; layer++, stride *= 2) {
+        int gridSize = (inputSize + stride - 1) / stride;
+        std::vector<std::pair<float, float>> boxes;
+
+        if (layer == 0) {
+            boxes = {{0.1f, 1.0f}, {scales[0], 2.0f}, {scales[0], 0.5f}};
+        } else {
+            for (float aspectRatio : aspectRatios)
+                boxes.push_back(std::make_pair(scales[layer], aspectRatio));
+
+            boxes.push_back(std::make_pair(std::sqrt(scales[layer] * scales[layer + 1]), 1.0f));
+        }
+
+        for (int y = 0; y < gridSize; y++) {
+            for (int x = 0; x < gridSize; x++) {
+                for (const std::pair<float, float> &box : boxes) {
+                    anchor cell;
+
+                    cell.yCenter = (y + 0.5f) / gridSize;
+                    cell.xCenter = (x + 0.5f) / gridSize;
+                    cell.height = box.first / std::sqrt(box.second);
+                    cell.width = box.first * std::sqrt(box.second);
+                    anchors.push_back(cell);
+                }
+            }
+        }
+    }
+}
+
+bool ssdAnchorDecoder::isValid() const
+{
+    return int(anchors.size()) == maximumCandidates && classCount > 0;
+}
+
+const char* ssdAnchorDecoder::getName() const
+{
+    return "SSD anchors";
+}
+
+/*
+ * The scores are logits, so rather than applying the sigmoid to every one
+ * they are compared against the logit of the threshold, and only the boxes
+ * that pass are decoded. Class 0 is the background
+ */
+void ssdAnchorDecoder::decode(tflite::Interpreter *interpreter, float minimumScore, detectionList &candidates) const
+{
+    const float *boxes = interpreter->typed_output_tensor<float>(boxIndex);
+    const float *logits = interpreter->typed_output_tensor<float>(scoreIndex);
+    float clampedScore = std::min(std::max(minimumScore, 1e-6f), 1.0f - 1e-6f);
+    float logitThreshold = std::log(clampedScore / (1.0f - clampedScore));
+
+    for (size_t i = 0; i < anchors.size(); i++) {
+        const float *classLogits = logits + i * size_t(classCount + 1) + 1;
+        const float *encoding = boxes + i * 4;
+        const anchor &cell = anchors[i];
+        float yCenter, xCenter, height, width;
+        detection item;
+
+        if (!anyAtLeast(classLogits, classCount, logitThreshold))
+            continue;
+
+        item.item = findLargest(classLogits, classCount);
+        item.confidence = 1.0f / (1.0f + std::exp(-classLogits[item.item]));
+
+        yCenter = encoding[0] / SSD_BOX_SCALE_XY * cell.height + cell.yCenter;
+        xCenter = encoding[1] / SSD_BOX_SCALE_XY * cell.width + cell.xCenter;
+        height = std::exp(encoding[2] / SSD_BOX_SCALE_WH) * cell.height;
+        width = std::exp(encoding[3] / SSD_BOX_SCALE_WH) * cell.width;
+
+        item.ymin = yCenter - height / 2;
+        item.xmin = xCenter - width / 2;
+        item.ymax = yCenter + height / 2;
+        item.xmax = xCenter + width / 2;
+        candidates.push_back(item);
+    }
+}
+
+yoloDecoder::yoloDecoder(int boxes, int classes, bool channelsFirst) :
+    classCount(classes), transposed(channelsFirst)
+{
+    maximumCandidates = boxes;
+}
+
+const char* yoloDecoder::getName() const
+{
+    return transposed ? "YOLO (channels first)" : "YOLO";
+}
+
+static void appendCentreBox(detectionList &candidates, int item, float confidence,
+                            float xCenter, float yCenter, float width, float height)
+{
+    detection box;
+
+    box.item = item;
+    box.confidence = confidence;
+    box.ymin = yCenter - height / 2;
+    box.xmin = xCenter - width / 2;
+    box.ymax = yCenter + height / 2;
+    box.xmax = xCenter + width / 2;
+    candidates.push_back(box);
+}
+
+void yoloDecoder::decode(tflite::Interpreter *interpreter, float minimumScore, detectionList &candidates) const
+{
+    const float *output = interpreter->typed_output_tensor<float>(0);
+
+    if (!transposed) {
+        /* Rows of centre x, centre y, width, height, objectness, class scores */
+        for (int i = 0; i < maximumCandidates; i++) {
+            const float *row = output + size_t(i) * size_t(classCount + 5);
+            int item;
+
+            /* The final score can not be higher than the objectness */
+            if (row[4] < minimumScore || !anyAtLeast(row + 5, classCount, minimumScore / row[4]))
+                continue;
+
+            item = findLargest(row + 5, classCount);
+            appendCentreBox(candidates, item, row[4] * row[5 + item], row[0], row[1], row[2], row[3]);
+        }
+
+        return;
+    }
+
+    /* One plane per value, so the best class score of four boxes at a time
+     * is found with a vector maximum across the class planes */
+    floatVector limit = {minimumScore, minimumScore, minimumScore, minimumScore};
+    size_t boxes = size_t(maximumCandidates);
+    int i = 0;
+
+    for (; i + DECODER_VECTOR_WIDTH <= maximumCandidates; i += DECODER_VECTOR_WIDTH) {
+        floatVector best;
+        intVector mask;
+
+        memcpy(&best, output + 4 * boxes + size_t(i), sizeof(best));
+
+        for (int item = 1; item < classCount; item++) {
+            floatVector scores;
+
+            memcpy(&scores, output + size_t(4 + item) * boxes + size_t(i), sizeof(scores));
+            best = scores > best ? scores : best;
+        }
+
+        mask = best >= limit;
+
+        for (int lane = 0; lane < DECODER_VECTOR_WIDTH; lane++) {
+            size_t box = size_t(i + lane);
+            int item = 0;
+
+            if (!mask[lane])
+                continue;
+
+            for (int candidate = 1; candidate < classCount; candidate++) {
+                if (output[size_t(4 + candidate) * boxes + box] > output[size_t(4 + item) * boxes + box])
+                    item = candidate;
+            }
+
+            appendCentreBox(candidates, item, best[lane], output[box], output[boxes + box],
+                            output[2 * boxes + box], output[3 * boxes + box]);
+        }
+    }
+
+    for (; i < maximumCandidates; i++) {
+        size_t box = size_t(i);
+        int item = 0;
+
+        for (int candidate = 1; candidate < classCount; candidate++) {
+            if (output[size_t(4 + candidate) * boxes + box] > output[size_t(4 + item) * boxes + box])
+                item = candidate;
+        }
+
+        if (output[size_t(4 + item) * boxes + box] >= minimumScore)
+            appendCentreBox(candidates, item, output[size_t(4 + item) * boxes + box], output[box],
+                            output[boxes + box], output[2 * boxes + box], output[3 * boxes + box]);
+    }
+}
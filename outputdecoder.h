@@ -0,0 +1,107 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef OUTPUTDECODER_H
+#define OUTPUTDECODER_H
+
+/* Anchor layout of the TensorFlow object detection API SSD models */
+#define SSD_ANCHOR_LAYERS 6
+#define SSD_ANCHOR_MIN_SCALE 0.2f
+#define SSD_ANCHOR_MAX_SCALE 0.95f
+#define SSD_BOX_SCALE_XY 10.0f
+#define SSD_BOX_SCALE_WH 5.0f
+
+#include <tensorflow/lite/interpreter.h>
+#include <tensorflow/lite/model.h>
+
+#include <memory>
+#include <vector>
+
+#include "detectionresult.h"
+
+/*
+ * Turns the output tensors of a detection model into candidate detections for
+ * the post-processing filter. The implementation is picked from the shapes of
+ * the model's outputs, so models with and without the TFLite detection
+ * post-process op can be used. Decoders hold no per-call state and can be
+ * shared between interpreters
+ */
+class outputDecoder
+{
+public:
+    virtual ~outputDecoder() {}
+    virtual void decode(tflite::Interpreter *interpreter, float minimumScore, detectionList &candidates) const = 0;
+    virtual const char* getName() const = 0;
+    int getMaximumCandidates() const;
+
+    static std::unique_ptr<outputDecoder> create(const tflite::Model *model);
+
+protected:
+    int maximumCandidates;
+};
+
+/* Boxes, classes, scores and count from TFLite_Detection_PostProcess */
+class postProcessDecoder : public outputDecoder
+{
+public:
+    explicit postProcessDecoder(int detections);
+    void decode(tflite::Interpreter *interpreter, float minimumScore, detectionList &candidates) const override;
+    const char* getName() const override;
+};
+
+/*
+ * Raw SSD box encodings [1, anchors, 4] and class logits
+ * [1, anchors, classes + 1] decoded against the standard SSD anchor grid
+ */
+class ssdAnchorDecoder : public outputDecoder
+{
+public:
+    ssdAnchorDecoder(int inputSize, int anchors, int classes, int boxOutput, int scoreOutput);
+    bool isValid() const;
+    void decode(tflite::Interpreter *interpreter, float minimumScore, detectionList &candidates) const override;
+    const char* getName() const override;
+
+private:
+    struct anchor {
+        float yCenter, xCenter, height, width;
+    };
+
+    std::vector<anchor> anchors;
+    int classCount;
+    int boxIndex;
+    int scoreIndex;
+};
+
+/*
+ * Single YOLO output, either [1, boxes, 5 + classes] with an objectness score
+ * (YOLOv5) or [1, 4 + classes, boxes] without one (YOLOv8). Boxes are centre,
+ * width and height normalised to the input size
+ */
+class yoloDecoder : public outputDecoder
+{
+public:
+    yoloDecoder(int boxes, int classes, bool channelsFirst);
+    void decode(tflite::Interpreter *interpreter, float minimumScore, detectionList &candidates) const override;
+    const char* getName() const override;
+
+private:
+    int classCount;
+    bool transposed;
+};
+
+#endif // OUTPUTDECODER_H
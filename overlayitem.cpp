@@ -0,0 +1,90 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QPainter>
+
+#include "mainwindow.h"
+#include "overlayitem.h"
+
+overlayItem::overlayItem()
+{
+    shownDetections = std::make_shared<const detectionList>();
+    setZValue(1);
+}
+
+void overlayItem::setLabels(const QStringList &labels)
+{
+    labelImages.setLabels(labels);
+}
+
+void overlayItem::setFrameSize(const QSizeF &size)
+{
+    if (size == frameSize)
+        return;
+
+    prepareGeometryChange();
+    frameSize = size;
+}
+
+/* Show a new set of detections, an empty list clears the overlay */
+void overlayItem::setDetections(const detectionResult &detections)
+{
+    if (shownDetections->empty() && detections->empty())
+        return;
+
+    shownDetections = detections;
+    update();
+}
+
+QRectF overlayItem::boundingRect() const
+{
+    return QRectF(QPointF(0, 0), frameSize);
+}
+
+void overlayItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    QTransform transform = painter->worldTransform();
+    QPen pen(BOX_COLOUR, BOX_WIDTH);
+
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+
+    if (shownDetections->empty())
+        return;
+
+    /* Boxes in frame coordinates, a cosmetic pen keeps their width on screen */
+    pen.setCosmetic(true);
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+
+    for (const detection &item : *shownDetections)
+        painter->drawRect(QRectF(QPointF(qreal(item.xmin) * frameSize.width(), qreal(item.ymin) * frameSize.height()),
+                                 QPointF(qreal(item.xmax) * frameSize.width(), qreal(item.ymax) * frameSize.height())));
+
+    /* Labels in device coordinates so they are never scaled */
+    painter->resetTransform();
+
+    for (const detection &item : *shownDetections) {
+        QPointF corner = transform.map(QPointF(qreal(item.xmin) * frameSize.width(),
+                                               qreal(item.ymin) * frameSize.height()));
+
+        painter->drawImage(corner, labelImages.getLabel(item.item, item.confidence));
+    }
+
+    painter->setWorldTransform(transform);
+}
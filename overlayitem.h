@@ -0,0 +1,48 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+#ifndef OVERLAYITEM_H
+#define OVERLAYITEM_H
+
+#include <QGraphicsItem>
+
+#include "detectionresult.h"
+#include "labelcache.h"
+
+/*
+ * Draws every detection box and label over the video in a single paint()
+ * call. Boxes follow the view transform like the frame beneath them, labels
+ * come from a labelCache and are drawn unscaled at the top left corner of
+ * their box
+ */
+class overlayItem : public QGraphicsItem
+{
+public:
+    overlayItem();
+    void setLabels(const QStringList &labels);
+    void setFrameSize(const QSizeF &size);
+    void setDetections(const detectionResult &detections);
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    QSizeF frameSize;
+    detectionResult shownDetections;
+    labelCache labelImages;
+};
+
+#endif // OVERLAYITEM_H
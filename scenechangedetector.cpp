@@ -0,0 +1,172 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QtGlobal>
+
+#include "latencystats.h"
+#include "scenechangedetector.h"
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SCENE_NEON
+#elif defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SCENE_X86
+#endif
+
+/* Sum of absolute differences, length must be a multiple of 16 */
+static quint64 sumAbsoluteDifferences(const uint8_t *first, const uint8_t *second, size_t length)
+{
+    quint64 sum = 0;
+    size_t i = 0;
+
+#if defined(SCENE_NEON)
+    uint32x4_t total = vdupq_n_u32(0);
+
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t difference = vabdq_u8(vld1q_u8(first + i), vld1q_u8(second + i));
+
+        total = vpadalq_u16(total, vpaddlq_u8(difference));
+    }
+
+    uint64x2_t lanes = vpaddlq_u32(total);
+
+    sum = vgetq_lane_u64(lanes, 0) + vgetq_lane_u64(lanes, 1);
+#elif defined(SCENE_X86)
+    __m128i total = _mm_setzero_si128();
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i));
+
+        total = _mm_add_epi64(total, _mm_sad_epu8(a, b));
+    }
+
+    quint64 lanes[2];
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), total);
+    sum = lanes[0] + lanes[1];
+#endif
+
+    for (; i < length; i++)
+        sum += quint64(first[i] > second[i] ? first[i] - second[i] : second[i] - first[i]);
+
+    return sum;
+}
+
+sceneChangeDetector::sceneChangeDetector(float changeThreshold) :
+    reference(SCENE_THUMBNAIL_WIDTH * SCENE_THUMBNAIL_HEIGHT),
+    current(SCENE_THUMBNAIL_WIDTH * SCENE_THUMBNAIL_HEIGHT),
+    referenceValid(false), threshold(changeThreshold), lastDifference(0.0f)
+{
+}
+
+const char* sceneChangeDetector::getInstructionSet()
+{
+#if defined(SCENE_NEON)
+    return "NEON";
+#elif defined(SCENE_X86)
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+
+/* The next frame is always reported as changed */
+void sceneChangeDetector::reset()
+{
+    referenceValid = false;
+}
+
+/* Mean absolute luma difference of the last frame checked, 0-255 */
+float sceneChangeDetector::getLastDifference() const
+{
+    return lastDifference;
+}
+
+/*
+ * Sample an RGB888 or UYVY frame into a SCENE_THUMBNAIL_WIDTH by
+ * SCENE_THUMBNAIL_HEIGHT luma image, each cell the mean of a
+ * SCENE_SAMPLES_PER_CELL square grid of points spread across it
+ */
+bool sceneChangeDetector::createThumbnail(const cv::Mat &frame, uint8_t *thumbnail)
+{
+    int bytesPerPixel = frame.type() == CV_8UC3 ? 3 : 2;
+    int cellWidth = frame.cols / SCENE_THUMBNAIL_WIDTH;
+    int cellHeight = frame.rows / SCENE_THUMBNAIL_HEIGHT;
+    int sampleX[SCENE_THUMBNAIL_WIDTH * SCENE_SAMPLES_PER_CELL];
+
+    if ((frame.type() != CV_8UC3 && frame.type() != CV_8UC2) || cellWidth == 0 || cellHeight == 0)
+        return false;
+
+    for (int x = 0; x < SCENE_THUMBNAIL_WIDTH * SCENE_SAMPLES_PER_CELL; x++)
+        sampleX[x] = (x * cellWidth / SCENE_SAMPLES_PER_CELL + cellWidth / (2 * SCENE_SAMPLES_PER_CELL)) *
+                     bytesPerPixel;
+
+    for (int y = 0; y < SCENE_THUMBNAIL_HEIGHT; y++) {
+        unsigned int sums[SCENE_THUMBNAIL_WIDTH] = {};
+
+        for (int row = 0; row < SCENE_SAMPLES_PER_CELL; row++) {
+            const uint8_t *line = frame.ptr<uint8_t>(y * cellHeight + row * cellHeight / SCENE_SAMPLES_PER_CELL +
+                                                     cellHeight / (2 * SCENE_SAMPLES_PER_CELL));
+
+            for (int x = 0; x < SCENE_THUMBNAIL_WIDTH * SCENE_SAMPLES_PER_CELL; x++) {
+                const uint8_t *pixel = line + sampleX[x];
+
+                /* BT.601 luma in Q8 for RGB, UYVY carries it in the odd bytes */
+                if (bytesPerPixel == 3)
+                    sums[x / SCENE_SAMPLES_PER_CELL] += (77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2]) >> 8;
+                else
+                    sums[x / SCENE_SAMPLES_PER_CELL] += pixel[1];
+            }
+        }
+
+        for (int x = 0; x < SCENE_THUMBNAIL_WIDTH; x++)
+            thumbnail[y * SCENE_THUMBNAIL_WIDTH + x] =
+                    uint8_t(sums[x] / (SCENE_SAMPLES_PER_CELL * SCENE_SAMPLES_PER_CELL));
+    }
+
+    return true;
+}
+
+/*
+ * Compare the frame with the reference. Frames that can not be checked are
+ * reported as changed, so inference still runs on them
+ */
+bool sceneChangeDetector::hasChanged(const cv::Mat &frame)
+{
+    stageTimer timer(STAGE_SCENE_CHANGE);
+
+    if (!createThumbnail(frame, current.data())) {
+        referenceValid = false;
+        return true;
+    }
+
+    if (referenceValid) {
+        lastDifference = float(sumAbsoluteDifferences(current.data(), reference.data(), current.size())) /
+                         current.size();
+
+        if (lastDifference < threshold)
+            return false;
+    }
+
+    reference.swap(current);
+    referenceValid = true;
+
+    return true;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+#ifndef SCENECHANGEDETECTOR_H
+#define SCENECHANGEDETECTOR_H
+
+#define SCENE_THUMBNAIL_WIDTH 64
+#define SCENE_THUMBNAIL_HEIGHT 48
+#define SCENE_SAMPLES_PER_CELL 4
+
+#include <opencv2/core.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Decides whether a frame differs enough from the last frame inference ran on
+ * to be worth running it again. Frames are reduced to a small luma thumbnail,
+ * each cell the mean of a few samples to suppress sensor noise, and compared
+ * with the reference thumbnail by their mean absolute difference. The
+ * reference only moves on when a change is reported, so a slow drift still
+ * adds up to a change eventually
+ */
+class sceneChangeDetector
+{
+public:
+    explicit sceneChangeDetector(float changeThreshold);
+    bool hasChanged(const cv::Mat &frame);
+    void reset();
+    float getLastDifference() const;
+    static const char* getInstructionSet();
+
+private:
+    bool createThumbnail(const cv::Mat &frame, uint8_t *thumbnail);
+
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> current;
+    bool referenceValid;
+    float threshold;
+    float lastDifference;
+};
+
+#endif // SCENECHANGEDETECTOR_H
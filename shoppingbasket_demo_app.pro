@@ -16,7 +16,7 @@
 # along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
 #*****************************************************************************************
 
-QT += core gui multimedia widgets
+QT += core gui multimedia widgets concurrent
 
 CONFIG += c++14
 
@@ -24,16 +24,53 @@ CONFIG += c++14
 #DEFINES += SBD_X86
 
 SOURCES += \
+    armnncache.cpp \
+    benchmark.cpp \
+    detectionfilter.cpp \
+    detectionpipeline.cpp \
+    detectionresult.cpp \
+    imagepreprocessor.cpp \
+    jpegdecoder.cpp \
+    labelcache.cpp \
+    latencystats.cpp \
     main.cpp \
     mainwindow.cpp \
+    mediacontroller.cpp \
+    objecttracker.cpp \
     opencvworker.cpp \
+    opprofiler.cpp \
+    outputdecoder.cpp \
+    overlayitem.cpp \
+    scenechangedetector.cpp \
+    startuptimeline.cpp \
     tfliteworker.cpp \
+    v4l2camera.cpp \
+    videoitem.cpp \
     videoworker.cpp
 
 HEADERS += \
+    armnncache.h \
+    benchmark.h \
+    boundedqueue.h \
+    detectionfilter.h \
+    detectionpipeline.h \
+    detectionresult.h \
+    imagepreprocessor.h \
+    jpegdecoder.h \
+    labelcache.h \
+    latencystats.h \
     mainwindow.h \
+    mediacontroller.h \
+    objecttracker.h \
     opencvworker.h \
+    opprofiler.h \
+    outputdecoder.h \
+    overlayitem.h \
+    scenechangedetector.h \
+    startuptimeline.h \
     tfliteworker.h \
+    v4l2camera.h \
+    videoitem.h \
     videoworker.h
 
 FORMS += \
@@ -51,6 +88,7 @@ LIBS += \
     -lopencv_imgcodecs \
     -lopencv_videoio \
     -ltensorflow-lite \
+    -lturbojpeg \
     -ldl \
     -lutil
 
@@ -59,4 +97,12 @@ LIBS += \
     -larmnn \
     -larmnnDelegate \
     -larmnnUtils
+}
+
+contains(DEFINES, SBD_X86) {
+LIBS += \
+    -lXNNPACK \
+    -lpthreadpool \
+    -lcpuinfo \
+    -lclog
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+#include "startuptimeline.h"
+
+startupTimeline::startupTimeline() :
+    startTime(std::chrono::steady_clock::now()), completed(false)
+{}
+
+/* The first call starts the clock */
+startupTimeline& startupTimeline::instance()
+{
+    static startupTimeline timeline;
+
+    return timeline;
+}
+
+void startupTimeline::setLogLocation(const QString &fileName)
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+
+    logLocation = fileName;
+}
+
+void startupTimeline::mark(const char *task, const QString &event)
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+    qint64 elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - startTime).count();
+
+    if (!completed)
+        events.push_back({elapsed, task, event});
+}
+
+/* Write the timeline, in the order the events happened, and log the total */
+void startupTimeline::complete()
+{
+    std::lock_guard<std::mutex> lock(timelineMutex);
+    QFile file(logLocation);
+    QTextStream stream(&file);
+
+    if (completed)
+        return;
+
+    completed = true;
+
+    if (events.empty())
+        return;
+
+    qInfo("Startup took %.1f ms", events.back().microseconds / 1000.0);
+
+    if (logLocation.isEmpty())
+        return;
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "Could not write the startup timeline to" << logLocation;
+        return;
+    }
+
+    for (const timelineEvent &event : events)
+        stream << QString("%1 ms  %2  %3\n").arg(event.microseconds / 1000.0, 9, 'f', 1)
+                  .arg(event.task, -8).arg(event.event);
+
+    qInfo() << "Startup timeline written to" << logLocation;
+}
@@ -0,0 +1,58 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+#include <QString>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+/*
+ * Records when each step of application startup happens, and on which task,
+ * so the concurrent camera, model and UI start up can be followed. The
+ * timeline is written to a file once startup is complete, later marks are
+ * ignored
+ */
+class startupTimeline
+{
+public:
+    static startupTimeline& instance();
+    void setLogLocation(const QString &fileName);
+    void mark(const char *task, const QString &event);
+    void complete();
+
+private:
+    struct timelineEvent {
+        qint64 microseconds;
+        QString task;
+        QString event;
+    };
+
+    startupTimeline();
+
+    std::mutex timelineMutex;
+    std::chrono::steady_clock::time_point startTime;
+    std::vector<timelineEvent> events;
+    QString logLocation;
+    bool completed;
+};
+
+#endif // STARTUPTIMELINE_H
@@ -16,92 +16,885 @@
  * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
  *****************************************************************************************/
 
-#include <chrono>
+#include <QDebug>
+#include <QStringList>
+#include <QTextStream>
 
-#include "tfliteworker.h"
+#include <algorithm>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-#include <opencv2/imgproc/imgproc.hpp>
+#include "latencystats.h"
+#include "opencvworker.h"
+#include "startuptimeline.h"
+#include "tfliteworker.h"
 
-#ifndef SBD_X86
+#ifdef SBD_X86
+#include <tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h>
+#else
 #include <armnn/ArmNN.hpp>
 #include <armnn/Utils.hpp>
+#include <armnn/Version.hpp>
 #include <delegate/armnn_delegate.hpp>
 #include <delegate/DelegateOptions.hpp>
 #endif
 
-tfliteWorker::tfliteWorker(QString modelLocation, bool armnnDelegate, int defaultThreads)
+/* Lock a range into memory, which also faults every page of it in */
+static void lockPages(const void *start, size_t length, const char *description)
 {
-    tflite::ops::builtin::BuiltinOpResolver tfliteResolver;
-    TfLiteIntArray *wantedDimensions;
+    uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+    uintptr_t first = reinterpret_cast<uintptr_t>(start) & ~(pageSize - 1);
+    uintptr_t last = reinterpret_cast<uintptr_t>(start) + length;
+
+    if (length == 0)
+        return;
+
+    if (mlock(reinterpret_cast<const void*>(first), last - first) != 0)
+        qWarning("Could not lock %s in memory, errno: %d. The limit can be raised with ulimit -l",
+                 description, errno);
+}
+
+tfliteWorker::tfliteWorker(QString modelLocation, bool useDelegate, const inferenceSettings &settings) :
+    jobQueue(size_t(std::max(settings.interpreterCount, 1))), lastRequestId(0), lastCancelledId(0),
+    emittingResults(false), activeVariant(useDelegate ? VARIANT_DELEGATE : VARIANT_TFLITE), stopping(false)
+{
+    const tflite::SubGraph *subgraph;
+    const tflite::Tensor *inputTensor;
+    const flatbuffers::Vector<int32_t> *inputShape;
 
+    /* The model is memory mapped once and shared by every interpreter */
     tfliteModel = tflite::FlatBufferModel::BuildFromFile(modelLocation.toStdString().c_str());
-    tflite::InterpreterBuilder(*tfliteModel, tfliteResolver) (&tfliteInterpreter);
 
+    if (tfliteModel == nullptr)
+        qFatal("Failed to load %s", modelLocation.toStdString().c_str());
+
+    startupTimeline::instance().mark("model", "Model mapped");
+
+    /* Fault the weights in now and keep them resident */
+    if (settings.lockMemory)
+        lockPages(tfliteModel->allocation()->base(), tfliteModel->allocation()->bytes(), "the model");
+
+    /* Read the input size from the model, the interpreters may not exist yet */
+    subgraph = tfliteModel->GetModel()->subgraphs()->Get(0);
+    inputTensor = subgraph->tensors()->Get(subgraph->inputs()->Get(0));
+    inputShape = inputTensor->shape();
+    wantedHeight = inputShape->Get(1);
+    wantedWidth = inputShape->Get(2);
+    wantedChannels = inputShape->Get(3);
+
+    /* Preprocessing writes straight into the input tensor in its own type */
+    if (inputTensor->type() == tflite::TensorType_INT8) {
+        const tflite::QuantizationParameters *quantization = inputTensor->quantization();
+
+        if (quantization == nullptr || quantization->scale() == nullptr || quantization->scale()->size() == 0 ||
+            quantization->zero_point() == nullptr || quantization->zero_point()->size() == 0)
+            qFatal("The int8 input of %s has no quantisation parameters", modelLocation.toStdString().c_str());
+
+        inputEncoding = tensorEncoding(TENSOR_TYPE_INT8, settings.inputMean, settings.inputDeviation,
+                                       quantization->scale()->Get(0), int(quantization->zero_point()->Get(0)));
+        qInfo() << "Input tensor: int8, scale" << quantization->scale()->Get(0)
+                << "zero point" << quantization->zero_point()->Get(0);
+    } else if (inputTensor->type() == tflite::TensorType_FLOAT32) {
+        inputEncoding = tensorEncoding(TENSOR_TYPE_FLOAT32, settings.inputMean, settings.inputDeviation, 1.0f, 0);
+        qInfo() << "Input tensor: float32";
+    } else if (inputTensor->type() != tflite::TensorType_UINT8) {
+        qFatal("The input of %s is not uint8, int8 or float32", modelLocation.toStdString().c_str());
+    }
+
+    decoder = outputDecoder::create(tfliteModel->GetModel());
+
+    if (decoder == nullptr)
+        qFatal("The outputs of %s are not supported", modelLocation.toStdString().c_str());
+
+    qInfo() << "Output decoder:" << decoder->getName();
+
+    maximumDetections = decoder->getMaximumCandidates();
+    resultPool.reset(new detectionPool(size_t(maximumDetections)));
+
+    detectionFilter filter(float(DETECT_THRESHOLD), settings.nmsIouThreshold, settings.topK);
+
+    if (!settings.thresholdsLocation.isEmpty())
+        filter.loadThresholds(settings.thresholdsLocation);
+
+    for (int i = 0; i < std::max(settings.interpreterCount, 1); i++) {
+        std::unique_ptr<interpreterSlot> slot(new interpreterSlot);
+
+        slot->filter.reset(new detectionFilter(filter));
+        slot->candidates.reserve(size_t(maximumDetections));
+
+        slot->threads = settings.defaultThreads;
+        slot->invocations = 0;
+        slot->busyMicroseconds = 0;
+        slot->invokeTotalMicroseconds = 0;
+
+        for (int variant = 0; variant < INTERPRETER_VARIANTS; variant++) {
+            slot->coldMicroseconds[variant] = 0;
+            slot->warmMicroseconds[variant] = 0;
+            slot->firstRequestMicroseconds[variant] = 0;
+        }
+
+        if (i < settings.cpuSets.size() && !settings.cpuSets[i].isEmpty()) {
+            slot->cpuSet = settings.cpuSets[i];
+
+            /* Use one inference thread for each CPU the interpreter owns */
+            slot->threads = slot->cpuSet.size();
+        }
+
+        interpreterSlots.push_back(std::move(slot));
+    }
+
+    for (int variant = 0; variant < INTERPRETER_VARIANTS; variant++)
+        variantBuilt[variant] = false;
+
+    warmupPending = false;
+    warmupRunning = false;
+
+    modelPath = modelLocation;
+    workerSettings = settings;
+
+    if (workerSettings.armnnBackends.isEmpty())
+        workerSettings.armnnBackends << "CpuAcc";
+
+    profileLocation = settings.profileLocation;
+    profileTitle = QString("%1, %2 interpreter(s)").arg(modelLocation).arg(interpreterSlots.size());
+
+    startTime = std::chrono::steady_clock::now();
+
+    /* Building the interpreters, delegate partitioning included, can take
+     * seconds, so it happens in the background. Requests wait until the
+     * variant they need is ready */
+    builderThread = std::thread(&tfliteWorker::buildInterpreters, this);
+
+    for (std::unique_ptr<interpreterSlot> &slot : interpreterSlots)
+        slot->thread = std::thread(&tfliteWorker::interpreterLoop, this, slot.get());
+}
+
+tfliteWorker::~tfliteWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(variantMutex);
+        stopping = true;
+    }
+
+    variantCondition.notify_all();
+    jobQueue.close();
+
+    for (std::unique_ptr<interpreterSlot> &slot : interpreterSlots)
+        slot->thread.join();
+
+    builderThread.join();
+
+    qInfo().noquote() << getStatistics();
+
+    if (!profileLocation.isEmpty())
+        writeProfile();
+}
+
+/*
+ * Build the variant in use first, then the other one, so that switching the
+ * delegate on or off later is instant
+ */
+void tfliteWorker::buildInterpreters()
+{
+    int firstVariant = activeVariant;
+
+    for (int variant : {firstVariant, 1 - firstVariant}) {
 #ifndef SBD_X86
-    /* Setup the delegate */
-    if(armnnDelegate == true) {
-        std::vector<armnn::BackendId> backends = {armnn::Compute::CpuAcc};
-        armnnDelegate::DelegateOptions delegateOptions(backends);
-        std::unique_ptr<TfLiteDelegate, decltype(&armnnDelegate::TfLiteArmnnDelegateDelete)>
-            armnnTfLiteDelegate(armnnDelegate::TfLiteArmnnDelegateCreate(delegateOptions),
-            armnnDelegate::TfLiteArmnnDelegateDelete);
+        /* Only the GpuAcc backend can store its compiled network, CpuAcc
+         * always optimises from scratch */
+        if (variant == VARIANT_DELEGATE && !workerSettings.armnnCacheDirectory.isEmpty() &&
+            workerSettings.armnnBackends.contains("GpuAcc"))
+            networkCache.reset(new armnnCache(workerSettings.armnnCacheDirectory, modelPath, ARMNN_VERSION,
+                                              workerSettings.armnnBackends, workerSettings.armnnFp16,
+                                              workerSettings.armnnFastMath));
+#endif
 
-        /* Instruct the Interpreter to use the armnnDelegate */
-        if (tfliteInterpreter->ModifyGraphWithDelegate(std::move(armnnTfLiteDelegate)) != kTfLiteOk)
-           qWarning("Delegate could not be used to modify the graph\n");
+        for (std::unique_ptr<interpreterSlot> &slot : interpreterSlots) {
+            if (stopping)
+                return;
+
+            buildInterpreter(slot.get(), interpreterVariant(variant));
+            warmUp(slot.get(), interpreterVariant(variant));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(variantMutex);
+            variantBuilt[variant] = true;
+        }
+
+        variantCondition.notify_all();
+        startupTimeline::instance().mark("model", QString("%1 interpreters built")
+                                         .arg(variant == VARIANT_DELEGATE ? DELEGATE_NAME : "TFLite"));
+        emit interpretersReady();
+    }
+
+    /* The variant switched to has been idle, so warm it up again */
+    while (true) {
+        int variant;
+
+        {
+            std::unique_lock<std::mutex> lock(variantMutex);
+
+            variantCondition.wait(lock, [this]() { return warmupPending || stopping; });
+
+            if (stopping)
+                return;
+
+            warmupPending = false;
+            warmupRunning = true;
+            variant = activeVariant;
+        }
+
+        for (std::unique_ptr<interpreterSlot> &slot : interpreterSlots)
+            warmUp(slot.get(), interpreterVariant(variant));
+
+        {
+            std::lock_guard<std::mutex> lock(variantMutex);
+            warmupRunning = false;
+        }
+
+        variantCondition.notify_all();
     }
+}
+
+void tfliteWorker::buildInterpreter(interpreterSlot *slot, interpreterVariant variant)
+{
+    tflite::ops::builtin::BuiltinOpResolver tfliteResolver;
+    std::unique_ptr<tflite::Interpreter> &interpreter = slot->interpreters[variant];
+
+    tflite::InterpreterBuilder(*tfliteModel, tfliteResolver) (&interpreter);
+
+    /* Setup the delegate */
+    if (variant == VARIANT_DELEGATE) {
+#ifdef SBD_X86
+        applyXnnpackDelegate(interpreter.get(), slot->threads);
+#else
+        bool cached = networkCache != nullptr && networkCache->isValid();
+
+        if (!applyArmnnDelegate(interpreter.get(), cached) && cached) {
+            /* The cached network could not be loaded, build it from scratch */
+            qWarning("Discarding the stale ArmNN network cache");
+            networkCache->invalidate();
+            cached = false;
+
+            tflite::InterpreterBuilder(*tfliteModel, tfliteResolver) (&interpreter);
+            applyArmnnDelegate(interpreter.get(), false);
+        }
+
+        if (networkCache != nullptr && !cached)
+            networkCache->markValid();
 #endif
 
-    if (tfliteInterpreter->AllocateTensors() != kTfLiteOk)
+        /* Every slot is partitioned the same way, so report it once */
+        if (slot == interpreterSlots[0].get())
+            reportDelegateCoverage(interpreter.get());
+    }
+
+    if (interpreter->AllocateTensors() != kTfLiteOk)
         qFatal("Failed to allocate tensors!");
 
-    tfliteInterpreter->SetProfiler(nullptr);
-    tfliteInterpreter->SetNumThreads(defaultThreads);
+    if (workerSettings.lockMemory)
+        lockArenas(interpreter.get());
+
+    if (profileLocation.isEmpty()) {
+        interpreter->SetProfiler(nullptr);
+    } else {
+        slot->profilers[variant].reset(new opProfiler(interpreter.get()));
+        interpreter->SetProfiler(slot->profilers[variant].get());
+    }
 
-    wantedDimensions = tfliteInterpreter->tensor(tfliteInterpreter->inputs()[0])->dims;
-    wantedHeight = wantedDimensions->data[1];
-    wantedWidth = wantedDimensions->data[2];
-    wantedChannels = wantedDimensions->data[3];
+    interpreter->SetNumThreads(slot->threads);
 }
 
+#ifdef SBD_X86
+/* Hand the graph to the XNNPACK delegate, using the slot's thread count */
+bool tfliteWorker::applyXnnpackDelegate(tflite::Interpreter *interpreter, int threads)
+{
+    TfLiteXNNPackDelegateOptions delegateOptions = TfLiteXNNPackDelegateOptionsDefault();
+
+    delegateOptions.num_threads = threads;
+
+    std::unique_ptr<TfLiteDelegate, decltype(&TfLiteXNNPackDelegateDelete)>
+        xnnpackDelegate(TfLiteXNNPackDelegateCreate(&delegateOptions), TfLiteXNNPackDelegateDelete);
+
+    if (interpreter->ModifyGraphWithDelegate(std::move(xnnpackDelegate)) != kTfLiteOk) {
+        qWarning("Delegate could not be used to modify the graph\n");
+        return false;
+    }
+
+    return true;
+}
+#else
 /*
- * Resize the input image and manipulate the data such that the alpha channel
- * is removed. Input the data to the tensor and output the results into a vector.
- * Also measure the time it takes for this function to complete
+ * Hand the graph to the ArmNN delegate with the configured backends and
+ * options. With a network cache the compiled network is either loaded from
+ * it or saved to it
  */
-void tfliteWorker::receiveImage(const cv::Mat& sentMat)
+bool tfliteWorker::applyArmnnDelegate(tflite::Interpreter *interpreter, bool loadCache)
 {
-    cv::Mat sentImageMat;
-    std::chrono::high_resolution_clock::time_point startTime, stopTime;
-    int timeElapsed;
-    int input;
+    std::vector<armnn::BackendId> backends;
+    armnn::OptimizerOptions optimizerOptions;
 
-    if(sentMat.empty()) {
-        qWarning("Received invalid image path, cannot run inference");
+    for (const QString &backend : workerSettings.armnnBackends)
+        backends.push_back(armnn::BackendId(backend.toStdString()));
+
+    optimizerOptions.m_ReduceFp32ToFp16 = workerSettings.armnnFp16;
+
+    if (workerSettings.armnnFastMath) {
+        optimizerOptions.m_ModelOptions.push_back(armnn::BackendOptions("CpuAcc", {{"FastMathEnabled", true}}));
+        optimizerOptions.m_ModelOptions.push_back(armnn::BackendOptions("GpuAcc", {{"FastMathEnabled", true}}));
+    }
+
+    if (networkCache != nullptr)
+        optimizerOptions.m_ModelOptions.push_back(armnn::BackendOptions("GpuAcc", {
+            {"SaveCachedNetwork", !loadCache},
+            {"CachedNetworkFilePath", networkCache->getNetworkPath().toStdString()}}));
+
+    armnnDelegate::DelegateOptions delegateOptions(backends, optimizerOptions);
+    std::unique_ptr<TfLiteDelegate, decltype(&armnnDelegate::TfLiteArmnnDelegateDelete)>
+        armnnTfLiteDelegate(armnnDelegate::TfLiteArmnnDelegateCreate(delegateOptions),
+        armnnDelegate::TfLiteArmnnDelegateDelete);
+
+    /* Instruct the Interpreter to use the armnnDelegate */
+    if (interpreter->ModifyGraphWithDelegate(std::move(armnnTfLiteDelegate)) != kTfLiteOk) {
+       qWarning("Delegate could not be used to modify the graph\n");
+       return false;
+    }
+
+    return true;
+}
+#endif
+
+/* Whether requests can run straight away on the selected variant */
+bool tfliteWorker::isReady()
+{
+    std::lock_guard<std::mutex> lock(variantMutex);
+
+    return variantBuilt[activeVariant];
+}
+
+/*
+ * Switch between the plain and delegate interpreters. This only swaps the
+ * variant used for the next request, requests already running finish on the
+ * interpreter they started on
+ */
+void tfliteWorker::setDelegate(bool useDelegate)
+{
+    int variant = useDelegate ? VARIANT_DELEGATE : VARIANT_TFLITE;
+
+    if (activeVariant.exchange(variant) == variant || workerSettings.warmupRuns <= 0)
         return;
+
+    {
+        std::lock_guard<std::mutex> lock(variantMutex);
+        warmupPending = true;
     }
 
-    input = tfliteInterpreter->inputs()[0];
+    variantCondition.notify_all();
+}
+
+/*
+ * Log how much of the model the delegate took over. Each delegate kernel node
+ * in the execution plan replaces a partition of the original nodes, the rest
+ * of the plan runs on the builtin TFLite kernels
+ */
+void tfliteWorker::reportDelegateCoverage(tflite::Interpreter *interpreter)
+{
+    int partitions = 0;
+    int fallbackNodes = 0;
+    int originalNodes;
+    QStringList fallbackOps;
+
+    for (int node : interpreter->execution_plan()) {
+        const std::pair<TfLiteNode, TfLiteRegistration> *nodeAndRegistration =
+                interpreter->node_and_registration(node);
+
+        if (nodeAndRegistration->first.delegate != nullptr) {
+            partitions++;
+        } else {
+            QString opName = tflite::EnumNameBuiltinOperator(
+                        tflite::BuiltinOperator(nodeAndRegistration->second.builtin_code));
+
+            fallbackNodes++;
+
+            if (!fallbackOps.contains(opName))
+                fallbackOps << opName;
+        }
+    }
+
+    /* Delegate kernel nodes are appended after the original nodes */
+    originalNodes = int(interpreter->nodes_size()) - partitions;
+
+    qInfo().noquote() << QString("%1 delegate: %2 of %3 ops (%4%) in %5 partition(s), builtin kernels: %6")
+                         .arg(DELEGATE_NAME).arg(originalNodes - fallbackNodes).arg(originalNodes)
+                         .arg(originalNodes > 0 ? 100.0 * (originalNodes - fallbackNodes) / originalNodes : 0,
+                              0, 'f', 1)
+                         .arg(partitions).arg(fallbackOps.isEmpty() ? "none" : fallbackOps.join(", "));
+}
+
+/* Block until both variants of every interpreter have been built */
+void tfliteWorker::waitForInterpreters()
+{
+    for (int variant = 0; variant < INTERPRETER_VARIANTS; variant++)
+        waitForVariant(variant);
+}
+
+/*
+ * Block until the warm-up queued by the last delegate switch has finished, so
+ * it doesn't compete with timed requests
+ */
+void tfliteWorker::waitForWarmup()
+{
+    std::unique_lock<std::mutex> lock(variantMutex);
+
+    variantCondition.wait(lock, [this]() { return (!warmupPending && !warmupRunning) || stopping; });
+}
+
+/* Wait for the variant to be built, returns false if the worker is stopping */
+bool tfliteWorker::waitForVariant(int variant)
+{
+    std::unique_lock<std::mutex> lock(variantMutex);
+
+    variantCondition.wait(lock, [&]() { return variantBuilt[variant] || stopping; });
+
+    return !stopping;
+}
 
-    cv::resize(sentMat, sentImageMat, cv::Size(wantedHeight, wantedWidth));
+/*
+ * Take a request id ahead of submitting the request, so the caller can record
+ * the id before its result can arrive. No later result is emitted until the
+ * id has been submitted, so it must be passed to submitImage or submitInput
+ * straight away
+ */
+quint64 tfliteWorker::reserveRequest()
+{
+    std::lock_guard<std::mutex> lock(resultMutex);
 
-    memcpy(tfliteInterpreter->typed_tensor<uint8_t>(input), sentImageMat.data, sentImageMat.total() * sentImageMat.elemSize());
+    pendingRequests.insert(++lastRequestId);
+
+    return lastRequestId;
+}
+
+/*
+ * Queue an image for inference and return straight away. The image is copied,
+ * so the caller's buffer can be reused at once. The results are emitted
+ * through sendOutputTensor tagged with the returned id, or with requestId
+ * when one was reserved
+ */
+quint64 tfliteWorker::submitImage(const cv::Mat& image, quint64 requestId)
+{
+    inferenceJob job;
+
+    job.requestId = requestId;
+    job.image = image.clone();
+
+    return submitJob(std::move(job));
+}
+
+/*
+ * Queue an image that has already been through preprocessImage(). The image
+ * is not copied and is handed back with the results, so the caller must not
+ * modify it afterwards
+ */
+quint64 tfliteWorker::submitInput(const cv::Mat& image, std::vector<uint8_t> input, quint64 requestId)
+{
+    inferenceJob job;
+
+    job.requestId = requestId;
+    job.image = image;
+    job.input = std::move(input);
+
+    return submitJob(std::move(job));
+}
+
+quint64 tfliteWorker::submitJob(inferenceJob job)
+{
+    inferenceJob droppedJob;
+
+    if (job.requestId == 0)
+        job.requestId = reserveRequest();
+
+    job.submitTime = std::chrono::steady_clock::now();
+
+    quint64 requestId = job.requestId;
+
+    /* When every interpreter is busy the oldest waiting request makes way */
+    if (!jobQueue.push(std::move(job), droppedJob))
+        completeJob(droppedJob.requestId, nullptr);
+
+    return requestId;
+}
+
+/*
+ * Drop every request submitted so far. Requests that have not started are
+ * skipped and the results of those already running are discarded
+ */
+void tfliteWorker::cancelRequests()
+{
+    std::lock_guard<std::mutex> lock(resultMutex);
+
+    lastCancelledId = lastRequestId;
+}
+
+/* Pin the calling thread, any threads TFLite starts from it inherit the mask */
+static void pinThread(const QVector<int> &cpuSet)
+{
+    cpu_set_t cpus;
+
+    if (cpuSet.isEmpty())
+        return;
+
+    CPU_ZERO(&cpus);
+
+    for (int cpu : cpuSet)
+        CPU_SET(cpu, &cpus);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        qWarning("Could not pin the interpreter thread to the requested CPUs");
+}
+
+/*
+ * Lock the tensor arenas of an interpreter into memory. Each arena is one
+ * allocation, so the span of the tensors placed in it covers it
+ */
+void tfliteWorker::lockArenas(tflite::Interpreter *interpreter)
+{
+    for (TfLiteAllocationType arena : {kTfLiteArenaRw, kTfLiteArenaRwPersistent}) {
+        uintptr_t first = UINTPTR_MAX;
+        uintptr_t last = 0;
+
+        for (size_t i = 0; i < interpreter->tensors_size(); i++) {
+            const TfLiteTensor *tensor = interpreter->tensor(int(i));
+            uintptr_t start = reinterpret_cast<uintptr_t>(tensor->data.raw);
+
+            if (tensor->allocation_type != arena || tensor->data.raw == nullptr || tensor->bytes == 0)
+                continue;
+
+            first = std::min(first, start);
+            last = std::max(last, start + tensor->bytes);
+        }
+
+        if (last > first)
+            lockPages(reinterpret_cast<const void*>(first), last - first, "a tensor arena");
+    }
+}
+
+/*
+ * Invoke an interpreter on a blank input a few times, so that lazy kernel and
+ * delegate setup and the first touches of the weights and arena happen here
+ * rather than on the first request. The thread is pinned like the slot's own
+ * while it runs, as threads the interpreter starts inherit its CPUs
+ */
+void tfliteWorker::warmUp(interpreterSlot *slot, interpreterVariant variant)
+{
+    tflite::Interpreter *interpreter = slot->interpreters[variant].get();
+    TfLiteTensor *input = interpreter->tensor(interpreter->inputs()[0]);
+    const char *name = variant == VARIANT_DELEGATE ? DELEGATE_NAME : "TFLite";
+    std::lock_guard<std::mutex> lock(slot->invokeMutex);
+    cpu_set_t originalCpus;
+    size_t index = 0;
+
+    if (workerSettings.warmupRuns <= 0)
+        return;
+
+    while (interpreterSlots[index].get() != slot)
+        index++;
+
+    pthread_getaffinity_np(pthread_self(), sizeof(originalCpus), &originalCpus);
+    pinThread(slot->cpuSet);
+
+    /* Keep the warm-up out of the operator profile */
+    interpreter->SetProfiler(nullptr);
+    memset(input->data.raw, 0, input->bytes);
+
+    for (int run = 0; run < workerSettings.warmupRuns; run++) {
+        std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+
+        interpreter->Invoke();
+
+        quint64 elapsed = quint64(std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() - runStart).count());
+
+        /* Later warm-ups follow a delegate switch, so only the first is cold */
+        if (run == 0 && slot->coldMicroseconds[variant] == 0)
+            slot->coldMicroseconds[variant] = elapsed;
+
+        slot->warmMicroseconds[variant] = elapsed;
+    }
+
+    interpreter->SetProfiler(slot->profilers[variant].get());
+    pthread_setaffinity_np(pthread_self(), sizeof(originalCpus), &originalCpus);
+
+    qInfo("%s interpreter %d warmed up: cold %.1f ms, warm %.1f ms after %d run(s)", name, int(index),
+          slot->coldMicroseconds[variant] / 1000.0, slot->warmMicroseconds[variant] / 1000.0,
+          workerSettings.warmupRuns);
+}
+
+void tfliteWorker::interpreterLoop(interpreterSlot *slot)
+{
+    inferenceJob job;
+
+    pinThread(slot->cpuSet);
+
+    while (jobQueue.pop(job)) {
+        std::chrono::steady_clock::time_point jobStart = std::chrono::steady_clock::now();
+        int variant = activeVariant;
+        tflite::Interpreter *interpreter;
+        uint8_t *inputTensor;
+        inferenceResult result;
+        quint64 invokeMicroseconds;
+
+        if (job.requestId <= lastCancelledId) {
+            completeJob(job.requestId, nullptr);
+            continue;
+        }
+
+        if (!waitForVariant(variant)) {
+            completeJob(job.requestId, nullptr);
+            break;
+        }
+
+        std::unique_lock<std::mutex> invokeLock(slot->invokeMutex);
+
+        interpreter = slot->interpreters[variant].get();
+        inputTensor = reinterpret_cast<uint8_t*>(interpreter->tensor(interpreter->inputs()[0])->data.raw);
+
+        if (job.input.empty()) {
+            if (!preprocessImage(job.image, inputTensor, slot->preprocessor)) {
+                completeJob(job.requestId, nullptr);
+                continue;
+            }
+        } else {
+            stageTimer timer(STAGE_INPUT_COPY);
+
+            memcpy(inputTensor, job.input.data(), getInputSize());
+        }
+
+        std::shared_ptr<detectionList> detections = resultPool->acquire();
+
+        result.timeElapsed = invokeInterpreter(interpreter, slot->candidates, slot->filter->getMinimumThreshold(),
+                                               invokeMicroseconds);
+        slot->filter->apply(slot->candidates, *detections);
+        invokeLock.unlock();
+
+        result.detections = detections;
+        result.image = job.image;
+
+        if (slot->firstRequestMicroseconds[variant] == 0)
+            slot->firstRequestMicroseconds[variant] = invokeMicroseconds;
+
+        slot->invocations++;
+        slot->invokeTotalMicroseconds += invokeMicroseconds;
+        slot->busyMicroseconds += quint64(std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now() - jobStart).count());
+
+        latencyStats::instance().record(STAGE_REQUEST, quint64(std::chrono::duration_cast<std::chrono::microseconds>(
+                                        std::chrono::steady_clock::now() - job.submitTime).count()));
+
+        completeJob(job.requestId, &result);
+    }
+}
+
+/*
+ * Retire a request, a null result marks one that was dropped or cancelled.
+ * Results are held back until every earlier request has been retired, then
+ * emitted in order. They are emitted with resultMutex released, so receivers
+ * can take their own locks and submit requests. Only one thread emits at a
+ * time, any other leaves its results for that thread to pick up
+ */
+void tfliteWorker::completeJob(quint64 requestId, inferenceResult *result)
+{
+    std::vector<std::pair<quint64, inferenceResult>> readyResults;
+    std::unique_lock<std::mutex> lock(resultMutex);
+
+    pendingRequests.erase(requestId);
+
+    if (result != nullptr)
+        completedRequests[requestId] = std::move(*result);
+
+    if (emittingResults)
+        return;
+
+    emittingResults = true;
+
+    for (;;) {
+        while (!completedRequests.empty() &&
+               (pendingRequests.empty() || completedRequests.begin()->first < *pendingRequests.begin())) {
+            std::map<quint64, inferenceResult>::iterator next = completedRequests.begin();
+
+            readyResults.emplace_back(next->first, std::move(next->second));
+            completedRequests.erase(next);
+        }
+
+        if (readyResults.empty())
+            break;
+
+        lock.unlock();
+
+        for (const std::pair<quint64, inferenceResult> &ready : readyResults) {
+            if (ready.first > lastCancelledId)
+                emit sendOutputTensor(ready.second.detections, ready.second.timeElapsed,
+                                      ready.second.image, ready.first);
+        }
+
+        readyResults.clear();
+        lock.lock();
+    }
+
+    emittingResults = false;
+}
+
+/*
+ * Convert and resize an image into a buffer laid out like the input tensor,
+ * in the tensor's type. RGB888 and UYVY frames are accepted. This does not
+ * touch the interpreters, so it can run on any thread as long as each thread
+ * has its own imagePreprocessor
+ */
+bool tfliteWorker::preprocessImage(const cv::Mat& image, uint8_t *destination, imagePreprocessor &converter)
+{
+    stageTimer timer(STAGE_PREPROCESS);
+    pixelFormat format;
+
+    if(image.empty()) {
+        qWarning("Received invalid image path, cannot run inference");
+        return false;
+    }
+
+    if (image.type() == CV_8UC3) {
+        format = PIXEL_FORMAT_RGB888;
+    } else if (image.type() == CV_8UC2) {
+        format = PIXEL_FORMAT_UYVY;
+    } else {
+        qWarning("Received unsupported image format, cannot run inference");
+        return false;
+    }
+
+    converter.process(image.data, image.step, format, image.cols, image.rows,
+                      destination, wantedWidth, wantedHeight, &inputEncoding);
+
+    return true;
+}
+
+/*
+ * Run the interpreter on the data already in its input tensor and decode every
+ * detection scoring at least minimumScore into the candidate list, for the
+ * filter to reduce. Also measure the time it takes for the inference to
+ * complete, in milliseconds
+ */
+int tfliteWorker::invokeInterpreter(tflite::Interpreter *interpreter, detectionList &candidates, float minimumScore,
+                                    quint64 &invokeMicroseconds)
+{
+    std::chrono::high_resolution_clock::time_point startTime, stopTime;
 
     startTime = std::chrono::high_resolution_clock::now();
-    tfliteInterpreter->Invoke();
+    interpreter->Invoke();
     stopTime = std::chrono::high_resolution_clock::now();
 
-    for (int i = 0; tfliteInterpreter->typed_output_tensor<float>(2)[i] > float(DETECT_THRESHOLD)
-         && tfliteInterpreter->typed_output_tensor<float>(2)[i] <= float(1.0); i++) {
-        outputTensor.push_back(tfliteInterpreter->typed_output_tensor<float>(1)[i]);          //item
-        outputTensor.push_back(tfliteInterpreter->typed_output_tensor<float>(2)[i]);          //confidence
-        outputTensor.push_back(tfliteInterpreter->typed_output_tensor<float>(0)[i * 4]);      //box ymin
-        outputTensor.push_back(tfliteInterpreter->typed_output_tensor<float>(0)[i * 4 + 1]);  //box xmin
-        outputTensor.push_back(tfliteInterpreter->typed_output_tensor<float>(0)[i * 4 + 2]);  //box ymax
-        outputTensor.push_back(tfliteInterpreter->typed_output_tensor<float>(0)[i * 4 + 3]);  //box xmax
+    invokeMicroseconds = quint64(std::chrono::duration_cast<std::chrono::microseconds>(stopTime - startTime).count());
+    latencyStats::instance().record(STAGE_INVOKE, invokeMicroseconds);
+
+    stageTimer timer(STAGE_OUTPUT_PARSE);
+
+    candidates.clear();
+    decoder->decode(interpreter, minimumScore, candidates);
+
+    return int(std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime).count());
+}
+
+size_t tfliteWorker::getInputSize()
+{
+    return size_t(wantedWidth) * size_t(wantedHeight) * size_t(wantedChannels) * inputEncoding.getElementSize();
+}
+
+/* Requests run and the time spent invoking the interpreters for them, over every slot */
+void tfliteWorker::getInvokeTotals(quint64 &invocations, quint64 &microseconds)
+{
+    invocations = 0;
+    microseconds = 0;
+
+    for (const std::unique_ptr<interpreterSlot> &slot : interpreterSlots) {
+        invocations += slot->invocations;
+        microseconds += slot->invokeTotalMicroseconds;
+    }
+}
+
+/*
+ * Report the throughput and mean latency of each interpreter, used to find
+ * the best split of interpreters between the big and little cores
+ */
+QString tfliteWorker::getStatistics()
+{
+    double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    QString statistics;
+    QTextStream stream(&statistics);
+
+    stream << "Interpreter pool statistics over " << elapsedSeconds << " s";
+
+    for (size_t i = 0; i < interpreterSlots.size(); i++) {
+        interpreterSlot *slot = interpreterSlots[i].get();
+        quint64 invocations = slot->invocations;
+        QStringList cpus;
+
+        for (int cpu : slot->cpuSet)
+            cpus << QString::number(cpu);
+
+        stream << "\n  Interpreter " << i << " (CPUs: " << (cpus.isEmpty() ? "any" : cpus.join(","))
+               << "): " << invocations << " inferences, "
+               << (elapsedSeconds > 0 ? invocations / elapsedSeconds : 0) << " inferences/s, "
+               << (invocations > 0 ? slot->busyMicroseconds / invocations / 1000.0 : 0) << " ms mean";
+
+        /* The first request should run about as fast as the warm runs */
+        for (int variant = 0; variant < INTERPRETER_VARIANTS; variant++) {
+            if (slot->coldMicroseconds[variant] == 0 && slot->firstRequestMicroseconds[variant] == 0)
+                continue;
+
+            stream << "\n    " << (variant == VARIANT_DELEGATE ? DELEGATE_NAME : "TFLite")
+                   << " invoke: cold " << slot->coldMicroseconds[variant] / 1000.0
+                   << " ms, warm " << slot->warmMicroseconds[variant] / 1000.0
+                   << " ms, first request " << slot->firstRequestMicroseconds[variant] / 1000.0 << " ms";
+        }
     }
 
-    timeElapsed = int(std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime).count());
-    emit sendOutputTensor(outputTensor, timeElapsed, sentMat);
-    outputTensor.clear();
+    return statistics;
+}
+
+/* Combine the operator timings of every interpreter into one report per variant */
+void tfliteWorker::writeProfile()
+{
+    for (int variant = 0; variant < INTERPRETER_VARIANTS; variant++) {
+        std::map<std::pair<int, int>, opProfiler::opTotals> combined;
+        std::vector<opProfiler::opTotals> totals;
+
+        for (std::unique_ptr<interpreterSlot> &slot : interpreterSlots) {
+            if (slot->profilers[variant] == nullptr)
+                continue;
+
+            for (const opProfiler::opTotals &op : slot->profilers[variant]->getTotals()) {
+                std::pair<int, int> key(int(op.eventType), op.node);
+
+                if (combined.count(key) == 0) {
+                    combined[key] = op;
+                } else {
+                    combined[key].invocations += op.invocations;
+                    combined[key].totalMicroseconds += op.totalMicroseconds;
+                }
+            }
+        }
+
+        /* Skip the variant if it was never used */
+        if (combined.empty())
+            continue;
+
+        for (const std::pair<const std::pair<int, int>, opProfiler::opTotals> &entry : combined)
+            totals.push_back(entry.second);
+
+        if (opProfiler::writeReport(profileLocation, profileTitle + (variant == VARIANT_DELEGATE ?
+                                    ", TensorFlow Lite + " DELEGATE_NAME " delegate" : ", TensorFlow Lite"), totals))
+            qInfo() << "Operator profile written to" << profileLocation;
+    }
 }
@@ -22,29 +22,182 @@
 #include <tensorflow/lite/kernels/register.h>
 
 #include <QObject>
+#include <QStringList>
 #include <QVector>
 
 #include <opencv2/videoio.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "armnncache.h"
+#include "boundedqueue.h"
+#include "detectionfilter.h"
+#include "detectionresult.h"
+#include "imagepreprocessor.h"
+#include "opprofiler.h"
+#include "outputdecoder.h"
+
 #define DETECT_THRESHOLD 0.5
+#define INTERPRETER_VARIANTS 2
+#define INTERPRETER_WARMUP_RUNS 3
+
+#ifdef SBD_X86
+#define DELEGATE_NAME "XNNPACK"
+#else
+#define DELEGATE_NAME "ArmNN"
+#endif
+
+enum interpreterVariant { VARIANT_TFLITE, VARIANT_DELEGATE };
+
+struct inferenceSettings {
+    int interpreterCount;
+    int defaultThreads;
+    /* CPUs each interpreter's thread is pinned to, an empty set is unpinned */
+    QVector<QVector<int>> cpuSets;
+    /* File the per-operator profile is appended to, profiling is off if empty */
+    QString profileLocation;
+    /* ArmNN delegate tuning, the network cache is off if the directory is empty */
+    QStringList armnnBackends;
+    bool armnnFp16;
+    bool armnnFastMath;
+    QString armnnCacheDirectory;
+    /* Post-processing, an empty threshold file uses DETECT_THRESHOLD for
+     * every class and a topK of 0 keeps every detection */
+    QString thresholdsLocation;
+    float nmsIouThreshold;
+    int topK;
+    /* Normalisation for int8 and float32 input tensors, each pixel value v
+     * is given to the model as (v - inputMean) / inputDeviation */
+    float inputMean;
+    float inputDeviation;
+    /* Blank invocations run on each interpreter once it is built and after
+     * every delegate switch, and whether the model and the tensor arenas are
+     * locked into memory */
+    int warmupRuns;
+    bool lockMemory;
+};
 
+/*
+ * Runs the detection model on a pool of interpreters sharing one
+ * FlatBufferModel. Each interpreter has its own thread, optionally pinned to a
+ * set of CPUs, which takes the next queued request as soon as it is free.
+ * Every slot holds both a plain and a delegate interpreter, ArmNN on Arm and
+ * XNNPACK on x86, so the delegate can be switched without rebuilding anything.
+ * Results are emitted in request order regardless of which finishes first
+ */
 class tfliteWorker : public QObject
 {
     Q_OBJECT
 
 public:
-    tfliteWorker(QString modelLocation, bool armnnDelegate, int defaultThreads);
-    void receiveImage(const cv::Mat&);
+    tfliteWorker(QString modelLocation, bool useDelegate, const inferenceSettings &settings);
+    ~tfliteWorker();
+    quint64 reserveRequest();
+    quint64 submitImage(const cv::Mat& image, quint64 requestId = 0);
+    quint64 submitInput(const cv::Mat& image, std::vector<uint8_t> input, quint64 requestId = 0);
+    void cancelRequests();
+    void setDelegate(bool useDelegate);
+    void waitForInterpreters();
+    void waitForWarmup();
+    bool isReady();
+    bool preprocessImage(const cv::Mat& image, uint8_t *destination, imagePreprocessor &converter);
+    size_t getInputSize();
+    void getInvokeTotals(quint64 &invocations, quint64 &microseconds);
+    QString getStatistics();
 
 signals:
-    void sendOutputTensor(const QVector<float>&, int, const cv::Mat&);
+    void sendOutputTensor(const detectionResult&, int, const cv::Mat&, quint64);
+    void interpretersReady();
 
 private:
-    std::unique_ptr<tflite::Interpreter> tfliteInterpreter;
+    struct inferenceJob {
+        quint64 requestId;
+        std::chrono::steady_clock::time_point submitTime;
+        cv::Mat image;
+        std::vector<uint8_t> input;
+    };
+
+    struct inferenceResult {
+        detectionResult detections;
+        int timeElapsed;
+        cv::Mat image;
+    };
+
+    /* One interpreter for each variant, built in the background */
+    struct interpreterSlot {
+        /* Declared first so they outlive the interpreters using them */
+        std::unique_ptr<opProfiler> profilers[INTERPRETER_VARIANTS];
+        std::unique_ptr<tflite::Interpreter> interpreters[INTERPRETER_VARIANTS];
+        std::thread thread;
+        QVector<int> cpuSet;
+        int threads;
+        std::unique_ptr<detectionFilter> filter;
+        detectionList candidates;
+        imagePreprocessor preprocessor;
+        std::atomic<quint64> invocations;
+        std::atomic<quint64> busyMicroseconds;
+        std::atomic<quint64> invokeTotalMicroseconds;
+        /* Held while an interpreter runs, a warm-up can run next to requests */
+        std::mutex invokeMutex;
+        /* Invoke times of the first and last warm-up run and the first request */
+        std::atomic<quint64> coldMicroseconds[INTERPRETER_VARIANTS];
+        std::atomic<quint64> warmMicroseconds[INTERPRETER_VARIANTS];
+        std::atomic<quint64> firstRequestMicroseconds[INTERPRETER_VARIANTS];
+    };
+
+    quint64 submitJob(inferenceJob job);
+    void buildInterpreters();
+    void buildInterpreter(interpreterSlot *slot, interpreterVariant variant);
+    bool waitForVariant(int variant);
+    void warmUp(interpreterSlot *slot, interpreterVariant variant);
+    void lockArenas(tflite::Interpreter *interpreter);
+#ifdef SBD_X86
+    bool applyXnnpackDelegate(tflite::Interpreter *interpreter, int threads);
+#else
+    bool applyArmnnDelegate(tflite::Interpreter *interpreter, bool loadCache);
+#endif
+    void reportDelegateCoverage(tflite::Interpreter *interpreter);
+    void interpreterLoop(interpreterSlot *slot);
+    int invokeInterpreter(tflite::Interpreter *interpreter, detectionList &candidates, float minimumScore,
+                          quint64 &invokeMicroseconds);
+    void completeJob(quint64 requestId, inferenceResult *result);
+    void writeProfile();
+
     std::unique_ptr<tflite::FlatBufferModel> tfliteModel;
-    std::string modelName;
-    QVector<float> outputTensor;
+    std::vector<std::unique_ptr<interpreterSlot>> interpreterSlots;
+    boundedQueue<inferenceJob> jobQueue;
+    std::mutex resultMutex;
+    std::set<quint64> pendingRequests;
+    std::map<quint64, inferenceResult> completedRequests;
+    quint64 lastRequestId;
+    std::atomic<quint64> lastCancelledId;
+    bool emittingResults;
+    std::atomic<int> activeVariant;
+    std::thread builderThread;
+    std::mutex variantMutex;
+    std::condition_variable variantCondition;
+    bool variantBuilt[INTERPRETER_VARIANTS];
+    bool warmupPending;
+    bool warmupRunning;
+    std::atomic<bool> stopping;
+    std::chrono::steady_clock::time_point startTime;
     int wantedWidth, wantedHeight, wantedChannels;
+    tensorEncoding inputEncoding;
+    int maximumDetections;
+    QString profileLocation;
+    QString profileTitle;
+    QString modelPath;
+    inferenceSettings workerSettings;
+    std::unique_ptr<armnnCache> networkCache;
+    std::unique_ptr<detectionPool> resultPool;
+    std::unique_ptr<outputDecoder> decoder;
 };
 
 #endif // TFLITEWORKER_H
@@ -0,0 +1,330 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QDebug>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "v4l2camera.h"
+
+static int xioctl(int fd, unsigned long request, void *argument)
+{
+    int status;
+
+    do {
+        status = ioctl(fd, request, argument);
+    } while (status == -1 && errno == EINTR);
+
+    return status;
+}
+
+v4l2Camera::v4l2Camera(std::string deviceName)
+{
+    device = deviceName;
+    fd = -1;
+    streaming = false;
+    frameWidth = 0;
+    frameHeight = 0;
+    bytesPerLine = 0;
+    format = 0;
+}
+
+v4l2Camera::~v4l2Camera()
+{
+    release();
+}
+
+/* A frame rate of 0 leaves the driver's rate as it is */
+bool v4l2Camera::open(unsigned int width, unsigned int height, __u32 pixelFormat, unsigned int frameRate)
+{
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    release();
+
+    fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+
+    if (fd == -1) {
+        qWarning() << "Could not open file:" << device.c_str();
+        return false;
+    }
+
+    if (!setFormat(width, height, pixelFormat)) {
+        release();
+        return false;
+    }
+
+    if (frameRate > 0)
+        setFrameRate(frameRate);
+
+    if (!mapBuffers()) {
+        release();
+        return false;
+    }
+
+    for (unsigned int i = 0; i < buffers.size(); i++)
+        queueFrame(i);
+
+    if (xioctl(fd, VIDIOC_STREAMON, &type) == -1) {
+        qWarning() << "VIDIOC_STREAMON, errno:" << errno;
+        release();
+        return false;
+    }
+
+    streaming = true;
+
+    return true;
+}
+
+bool v4l2Camera::setFormat(unsigned int width, unsigned int height, __u32 pixelFormat)
+{
+    struct v4l2_format fmt;
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = width;
+    fmt.fmt.pix.height = height;
+    fmt.fmt.pix.pixelformat = pixelFormat;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+
+    if (xioctl(fd, VIDIOC_S_FMT, &fmt) == -1) {
+        qWarning() << "VIDIOC_S_FMT, errno:" << errno;
+        return false;
+    }
+
+    /* The driver is free to adjust the request, so use what it chose */
+    frameWidth = fmt.fmt.pix.width;
+    frameHeight = fmt.fmt.pix.height;
+    bytesPerLine = fmt.fmt.pix.bytesperline;
+    format = fmt.fmt.pix.pixelformat;
+
+    return true;
+}
+
+/* Not every driver lets the rate be set, so failing is only a warning */
+void v4l2Camera::setFrameRate(unsigned int frameRate)
+{
+    struct v4l2_streamparm parameters;
+
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    parameters.parm.capture.timeperframe.numerator = 1;
+    parameters.parm.capture.timeperframe.denominator = frameRate;
+
+    if (xioctl(fd, VIDIOC_S_PARM, &parameters) == -1) {
+        qWarning() << "VIDIOC_S_PARM, errno:" << errno;
+        return;
+    }
+
+    if (parameters.parm.capture.timeperframe.numerator != 0 &&
+        parameters.parm.capture.timeperframe.denominator / parameters.parm.capture.timeperframe.numerator != frameRate)
+        qWarning() << "Camera runs at" << parameters.parm.capture.timeperframe.denominator
+                   << "/" << parameters.parm.capture.timeperframe.numerator << "fps instead of" << frameRate;
+}
+
+bool v4l2Camera::mapBuffers()
+{
+    struct v4l2_requestbuffers request;
+
+    memset(&request, 0, sizeof(request));
+    request.count = V4L2_BUFFER_COUNT;
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd, VIDIOC_REQBUFS, &request) == -1) {
+        qWarning() << "VIDIOC_REQBUFS, errno:" << errno;
+        return false;
+    }
+
+    if (request.count < 2) {
+        qWarning("Not enough v4l2 buffers available");
+        return false;
+    }
+
+    for (unsigned int i = 0; i < request.count; i++) {
+        struct v4l2_buffer buffer;
+        struct v4l2_exportbuffer exportBuffer;
+        mappedBuffer mapping;
+
+        memset(&buffer, 0, sizeof(buffer));
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = i;
+
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buffer) == -1) {
+            qWarning() << "VIDIOC_QUERYBUF, errno:" << errno;
+            return false;
+        }
+
+        mapping.length = buffer.length;
+        mapping.start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, buffer.m.offset);
+
+        if (mapping.start == MAP_FAILED) {
+            qWarning() << "Could not map v4l2 buffer, errno:" << errno;
+            return false;
+        }
+
+        /* Export a DMABUF handle where the driver supports it, so the buffer
+         * can be shared with other devices without a copy */
+        memset(&exportBuffer, 0, sizeof(exportBuffer));
+        exportBuffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        exportBuffer.index = i;
+        exportBuffer.flags = O_RDONLY | O_CLOEXEC;
+
+        if (xioctl(fd, VIDIOC_EXPBUF, &exportBuffer) == -1)
+            mapping.dmabufFd = -1;
+        else
+            mapping.dmabufFd = exportBuffer.fd;
+
+        buffers.push_back(mapping);
+    }
+
+    return true;
+}
+
+void v4l2Camera::unmapBuffers()
+{
+    struct v4l2_requestbuffers request;
+
+    for (mappedBuffer &mapping : buffers) {
+        if (mapping.dmabufFd != -1)
+            ::close(mapping.dmabufFd);
+
+        munmap(mapping.start, mapping.length);
+    }
+
+    buffers.clear();
+
+    /* Free the driver side buffers */
+    memset(&request, 0, sizeof(request));
+    request.count = 0;
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    xioctl(fd, VIDIOC_REQBUFS, &request);
+}
+
+void v4l2Camera::release()
+{
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (fd == -1)
+        return;
+
+    if (streaming)
+        xioctl(fd, VIDIOC_STREAMOFF, &type);
+
+    streaming = false;
+    unmapBuffers();
+    ::close(fd);
+    fd = -1;
+}
+
+bool v4l2Camera::isOpened()
+{
+    return streaming;
+}
+
+/*
+ * Wait for the driver to fill a buffer and return a view of it. The view is
+ * only valid until the buffer is handed back with queueFrame()
+ */
+bool v4l2Camera::dequeueFrame(cv::Mat &frame, unsigned int &index)
+{
+    struct v4l2_buffer buffer;
+    struct pollfd pollDescriptor;
+    int status;
+
+    pollDescriptor.fd = fd;
+    pollDescriptor.events = POLLIN;
+
+    do {
+        status = poll(&pollDescriptor, 1, V4L2_DEQUEUE_TIMEOUT_MS);
+    } while (status == -1 && errno == EINTR);
+
+    if (status <= 0) {
+        qWarning("Timed out waiting for a v4l2 buffer");
+        return false;
+    }
+
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd, VIDIOC_DQBUF, &buffer) == -1) {
+        qWarning() << "VIDIOC_DQBUF, errno:" << errno;
+        return false;
+    }
+
+    index = buffer.index;
+
+    if (isCompressed())
+        frame = cv::Mat(1, int(buffer.bytesused), CV_8UC1, buffers[index].start);
+    else
+        frame = cv::Mat(int(frameHeight), int(frameWidth), CV_8UC2,
+                        buffers[index].start, bytesPerLine);
+
+    return true;
+}
+
+void v4l2Camera::queueFrame(unsigned int index)
+{
+    struct v4l2_buffer buffer;
+
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = index;
+
+    if (xioctl(fd, VIDIOC_QBUF, &buffer) == -1)
+        qWarning() << "VIDIOC_QBUF, errno:" << errno;
+}
+
+int v4l2Camera::getDmabufFd(unsigned int index)
+{
+    if (index >= buffers.size())
+        return -1;
+
+    return buffers[index].dmabufFd;
+}
+
+unsigned int v4l2Camera::getWidth()
+{
+    return frameWidth;
+}
+
+unsigned int v4l2Camera::getHeight()
+{
+    return frameHeight;
+}
+
+__u32 v4l2Camera::getPixelFormat()
+{
+    return format;
+}
+
+bool v4l2Camera::isCompressed()
+{
+    return format == V4L2_PIX_FMT_MJPEG || format == V4L2_PIX_FMT_JPEG;
+}
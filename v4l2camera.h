@@ -0,0 +1,76 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#ifndef V4L2CAMERA_H
+#define V4L2CAMERA_H
+
+#define V4L2_BUFFER_COUNT 4
+#define V4L2_DEQUEUE_TIMEOUT_MS 2000
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include <linux/types.h>
+
+/*
+ * Minimal V4L2 streaming capture using driver allocated mmap buffers.
+ * Frames are handed out as cv::Mat views over the mapped buffers, so no copy
+ * is made until the caller converts the frame. Compressed frames are handed
+ * out as a single row of bytes
+ */
+class v4l2Camera
+{
+public:
+    v4l2Camera(std::string deviceName);
+    ~v4l2Camera();
+    bool open(unsigned int width, unsigned int height, __u32 pixelFormat, unsigned int frameRate = 0);
+    void release();
+    bool isOpened();
+    bool dequeueFrame(cv::Mat &frame, unsigned int &index);
+    void queueFrame(unsigned int index);
+    int getDmabufFd(unsigned int index);
+    unsigned int getWidth();
+    unsigned int getHeight();
+    __u32 getPixelFormat();
+    bool isCompressed();
+
+private:
+    struct mappedBuffer {
+        void *start;
+        size_t length;
+        int dmabufFd;
+    };
+
+    bool setFormat(unsigned int width, unsigned int height, __u32 pixelFormat);
+    void setFrameRate(unsigned int frameRate);
+    bool mapBuffers();
+    void unmapBuffers();
+
+    std::string device;
+    int fd;
+    bool streaming;
+    unsigned int frameWidth;
+    unsigned int frameHeight;
+    unsigned int bytesPerLine;
+    __u32 format;
+    std::vector<mappedBuffer> buffers;
+};
+
+#endif // V4L2CAMERA_H
@@ -0,0 +1,79 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+
+#include <QPainter>
+
+#include <opencv2/imgproc.hpp>
+
+#include "latencystats.h"
+#include "videoitem.h"
+
+void videoItem::setSize(const QSize &size)
+{
+    if (size != frameImage.size())
+        prepareGeometryChange();
+}
+
+/*
+ * Convert an RGB888 or UYVY frame into the buffer. The buffer is only
+ * reallocated when the frame size changes or after setImage() shared it
+ */
+void videoItem::setFrame(const cv::Mat &frame)
+{
+    stageTimer timer(STAGE_MAT_TO_QIMAGE);
+    QSize size(frame.cols, frame.rows);
+
+    if (frame.empty())
+        return;
+
+    setSize(size);
+
+    if (frameImage.size() != size || frameImage.format() != QImage::Format_RGB32 || !frameImage.isDetached())
+        frameImage = QImage(size, QImage::Format_RGB32);
+
+    cv::Mat imageMat(frame.rows, frame.cols, CV_8UC4, frameImage.bits(), size_t(frameImage.bytesPerLine()));
+
+    /* Format_RGB32 is stored as BGRA in memory */
+    if (frame.type() == CV_8UC2)
+        cv::cvtColor(frame, imageMat, cv::COLOR_YUV2BGRA_UYVY);
+    else
+        cv::cvtColor(frame, imageMat, cv::COLOR_RGB2BGRA);
+
+    update();
+}
+
+/* Show an image that is already RGB32, it is shared rather than copied */
+void videoItem::setImage(const QImage &image)
+{
+    setSize(image.size());
+    frameImage = image;
+    update();
+}
+
+QRectF videoItem::boundingRect() const
+{
+    return QRectF(QPointF(0, 0), frameImage.size());
+}
+
+void videoItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+
+    painter->drawImage(QPointF(0, 0), frameImage);
+}
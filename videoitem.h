@@ -0,0 +1,48 @@
+/*****************************************************************************************
+ * Copyright (C) 2021 Renesas Electronics Corp.
+ * This file is part of the RZG Shopping Basket Demo.
+ *
+ * The RZG Shopping Basket Demo is free software using the Qt Open Source Model: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The RZG Shopping Basket Demo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
+ *****************************************************************************************/
+#ifndef VIDEOITEM_H
+#define VIDEOITEM_H
+
+#include <QGraphicsItem>
+#include <QImage>
+
+#include <opencv2/core.hpp>
+
+/*
+ * The camera frame shown in the graphics view. The item stays in the scene
+ * for the lifetime of the window and only its image changes, so no graphics
+ * items are created or destroyed per frame. Frames are converted once into
+ * a reused RGB32 buffer, the format QPainter draws without converting again,
+ * and are drawn at their native size, any scaling being left to the view
+ * transform
+ */
+class videoItem : public QGraphicsItem
+{
+public:
+    void setFrame(const cv::Mat &frame);
+    void setImage(const QImage &image);
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    void setSize(const QSize &size);
+
+    QImage frameImage;
+};
+
+#endif // VIDEOITEM_H
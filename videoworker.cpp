@@ -16,44 +16,182 @@
  * along with the RZG Shopping Basket Demo.  If not, see <https://www.gnu.org/licenses/>.
  *****************************************************************************************/
 
-#include <chrono>
-#include <thread>
+#include <QPainter>
+#include <QTimer>
 
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "latencystats.h"
+#include "mainwindow.h"
+#include "opencvworker.h"
 #include "videoworker.h"
 
-videoWorker::videoWorker(QObject *parent) :
-    QObject(parent), stopped(false), running(false), videoDelay(0)
+videoWorker::videoWorker(opencvWorker *capture, QObject *parent) :
+    QObject(parent), cvWorker(capture), frameTimer(nullptr), targetFps(VIDEO_TARGET_FPS),
+    frameRequested(false), renderMicroseconds(0), lastDisplayedSequence(0), displayedFrames(0),
+    droppedFrames(0), achievedMilliFps(0), windowFrames(0)
 {}
 
-void videoWorker::play_video()
+/* Runs on the worker's thread, so the timer is created there */
+void videoWorker::StartVideo()
+{
+    if (frameTimer == nullptr) {
+        frameTimer = new QTimer(this);
+        frameTimer->setTimerType(Qt::PreciseTimer);
+        connect(frameTimer, SIGNAL(timeout()), this, SLOT(scheduleFrame()));
+    }
+
+    /* Frames missed while the preview was stopped are not dropped ones */
+    frameRequested = false;
+    lastDisplayedSequence = 0;
+    windowStart = std::chrono::steady_clock::now();
+    windowFrames = displayedFrames;
+
+    updateInterval();
+    frameTimer->start();
+}
+
+void videoWorker::StopVideo()
+{
+    if (frameTimer != nullptr)
+        frameTimer->stop();
+
+    achievedMilliFps = 0;
+}
+
+void videoWorker::setTargetFps(unsigned int fps)
 {
-    if (!running || stopped) return;
+    targetFps = qMax(fps, 1u);
+}
+
+/*
+ * The frame period is the target one, stretched to the time the GUI has
+ * recently needed per frame plus some headroom so it can still handle input
+ */
+void videoWorker::updateInterval()
+{
+    quint64 targetMicroseconds = 1000000 / targetFps;
+    quint64 renderLimit = quint64(renderMicroseconds * VIDEO_RENDER_HEADROOM);
+    int interval = int((qMax(targetMicroseconds, renderLimit) + 500) / 1000);
+
+    if (frameTimer->interval() != interval)
+        frameTimer->setInterval(interval);
+}
+
+void videoWorker::scheduleFrame()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    qint64 windowMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now - windowStart).count();
+
+    if (windowMilliseconds >= VIDEO_FPS_WINDOW_MS) {
+        achievedMilliFps = (displayedFrames - windowFrames) * 1000000 / quint64(windowMilliseconds);
+        windowFrames = displayedFrames;
+        windowStart = now;
+    }
+
+    updateInterval();
+
+    /* Coalesce: the GUI will show the newest frame once it is free */
+    if (frameRequested)
+        return;
+
+    if (!cvWorker->getCaptureFailed() && cvWorker->getPublishedSequence() == lastDisplayedSequence)
+        return;
 
+    requestTime = now;
+    frameRequested = true;
     emit showVideo();
+}
+
+/*
+ * Called by the GUI thread once it has drawn a frame, or found there was no
+ * new one, in answer to showVideo()
+ */
+void videoWorker::frameDisplayed(quint64 sequence)
+{
+    quint64 elapsed = quint64(std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - requestTime).count());
+    quint64 previous = lastDisplayedSequence;
+    quint64 smoothed = renderMicroseconds;
 
-    /* Limit play_video loop speed */
-    if (videoDelay != 0)
-        std::this_thread::sleep_for(std::chrono::milliseconds(videoDelay));
+    if (sequence > previous) {
+        if (previous != 0 && sequence > previous + 1) {
+            droppedFrames += sequence - previous - 1;
+            latencyStats::instance().increment(COUNTER_DISPLAY_DROPPED, sequence - previous - 1);
+        }
 
-    /* Use QueuedConnection to give other threads a chance to be processed before next play_video */
-    QMetaObject::invokeMethod(this, "play_video", Qt::QueuedConnection);
+        lastDisplayedSequence = sequence;
+        displayedFrames++;
+        latencyStats::instance().increment(COUNTER_DISPLAY_SHOWN);
+    }
+
+    if (smoothed == 0)
+        renderMicroseconds = elapsed;
+    else
+        renderMicroseconds = quint64(smoothed + VIDEO_RENDER_SMOOTHING * (double(elapsed) - smoothed));
+
+    frameRequested = false;
 }
 
-void videoWorker::StopVideo()
+double videoWorker::getTargetFps()
 {
-    stopped = true;
-    running = false;
+    return targetFps;
 }
 
-void videoWorker::StartVideo()
+/* Frames shown per second over the last VIDEO_FPS_WINDOW_MS */
+double videoWorker::getAchievedFps()
+{
+    return achievedMilliFps / 1000.0;
+}
+
+quint64 videoWorker::getDroppedFrames()
+{
+    return droppedFrames;
+}
+
+/* Only call this while the render stage is stopped, the label cache is not shared */
+void videoWorker::setLabels(const QStringList &labels)
+{
+    labelImages.setLabels(labels);
+}
+
+/*
+ * Render stage of the live detection pipeline. Paint the detection boxes and
+ * labels over an RGB frame off the GUI thread, so the GUI only has to display
+ * the finished image
+ */
+void videoWorker::renderDetections(const cv::Mat &frame, const detectionResult &detections, int inferenceTime)
 {
-    stopped = false;
-    running = true;
+    stageTimer timer(STAGE_OVERLAY_RENDER);
+    QImage image(frame.cols, frame.rows, QImage::Format_RGB32);
+    cv::Mat imageMat(frame.rows, frame.cols, CV_8UC4, image.bits(), size_t(image.bytesPerLine()));
+    QPainter painter;
+    QPen pen;
+
+    /* Format_RGB32 is stored as BGRA in memory */
+    cv::cvtColor(frame, imageMat, cv::COLOR_RGB2BGRA);
+
+    pen.setColor(BOX_COLOUR);
+    pen.setWidth(BOX_WIDTH);
+
+    painter.begin(&image);
+    painter.setPen(pen);
+    painter.setBrush(Qt::NoBrush);
+
+    for (const detection &item : *detections) {
+        QRectF box(QPointF(qreal(item.xmin) * image.width(), qreal(item.ymin) * image.height()),
+                   QPointF(qreal(item.xmax) * image.width(), qreal(item.ymax) * image.height()));
+
+        painter.drawRect(box);
+        painter.drawImage(box.topLeft(), labelImages.getLabel(item.item, item.confidence));
+    }
+
+    painter.end();
 
-    play_video();
+    emit showDetections(image, detections, inferenceTime);
 }
 
-void videoWorker::setDelayMS(unsigned int delay)
+void videoWorker::reportCameraFailure()
 {
-    videoDelay = delay;
+    emit cameraFailure();
 }
@@ -19,30 +19,78 @@
 #ifndef VIDEOWORKER_H
 #define VIDEOWORKER_H
 
+#define VIDEO_TARGET_FPS 30
+#define VIDEO_MIPI_TARGET_FPS 20
+#define VIDEO_RENDER_HEADROOM 1.25
+#define VIDEO_RENDER_SMOOTHING 0.125
+#define VIDEO_FPS_WINDOW_MS 1000
+
+#include <QImage>
 #include <QObject>
+#include <QStringList>
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <chrono>
 
+#include "detectionresult.h"
+#include "labelcache.h"
+
+class opencvWorker;
+class QTimer;
+
+/*
+ * Paces the camera preview from its own thread. A precise timer ticks at the
+ * target frame rate, or slower if the GUI has been taking longer than that to
+ * show a frame, and each tick asks the GUI to show the newest frame only if
+ * the camera has published one and the GUI has finished with the previous
+ * request. Frames the camera produced that were never shown are counted as
+ * dropped. Also renders the live detection overlay for detectionPipeline
+ */
 class videoWorker : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit videoWorker(QObject *parent = 0);
-    void setDelayMS(unsigned int delay);
+    explicit videoWorker(opencvWorker *capture, QObject *parent = nullptr);
+    void setTargetFps(unsigned int fps);
+    void frameDisplayed(quint64 sequence);
+    double getTargetFps();
+    double getAchievedFps();
+    quint64 getDroppedFrames();
+    void setLabels(const QStringList &labels);
+    void renderDetections(const cv::Mat &frame, const detectionResult &detections, int inferenceTime);
+    void reportCameraFailure();
 
 signals:
     void showVideo();
+    void showDetections(const QImage&, const detectionResult&, int);
+    void cameraFailure();
 
 public slots:
     void StartVideo();
     void StopVideo();
 
 private slots:
-    void play_video();
+    void scheduleFrame();
 
 private:
-    bool stopped;
-    bool running;
-    unsigned int videoDelay;
+    void updateInterval();
+
+    opencvWorker *cvWorker;
+    QTimer *frameTimer;
+    std::atomic<unsigned int> targetFps;
+    std::atomic<bool> frameRequested;
+    std::chrono::steady_clock::time_point requestTime;
+    std::atomic<quint64> renderMicroseconds;
+    std::atomic<quint64> lastDisplayedSequence;
+    std::atomic<quint64> displayedFrames;
+    std::atomic<quint64> droppedFrames;
+    std::atomic<quint64> achievedMilliFps;
+    std::chrono::steady_clock::time_point windowStart;
+    quint64 windowFrames;
+    labelCache labelImages;
 };
 
 #endif // VIDEOWORKER_H